@@ -7,6 +7,10 @@
 #include "threads/interrupt.h"
 #include "threads/synch.h"
 #include "threads/thread.h"
+#ifdef VM
+#include "vm/merge.h"
+#include "vm/wset.h"
+#endif
   
 /* See [8254] for hardware details of the 8254 timer chip. */
 
@@ -172,6 +176,10 @@ timer_interrupt (struct intr_frame *args UNUSED)
 {
   ticks++;
   thread_tick ();
+#ifdef VM
+  wset_tick (ticks);
+  merge_tick (ticks);
+#endif
 }
 
 /* Returns true if LOOPS iterations waits for more than one timer
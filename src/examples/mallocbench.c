@@ -0,0 +1,156 @@
+/* mallocbench.c
+
+   Exercises the user-space malloc() with a mix of allocation
+   patterns, checking the contents of every block before it is
+   freed:
+
+     - SLOTS blocks of random small sizes, replaced at random.
+     - An array grown one element at a time with realloc().
+     - Large blocks of random sizes, freed in random order, so
+       that their neighbours must be merged.
+
+   Run it with a number of rounds, e.g.:
+
+      pintos -p mallocbench -a mallocbench -- -q run 'mallocbench 10'
+
+   and compare the tick count printed at shutdown, and the peak
+   memory use printed at the end. */
+
+#include <random.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syscall.h>
+
+#define SLOTS 512               /* Live small blocks. */
+#define SMALL_MAX 256           /* Largest small block, in bytes. */
+#define ARRAY_LEN 16384         /* Elements in the growing array. */
+#define LARGE_CNT 32            /* Live large blocks. */
+#define LARGE_MAX 32768         /* Largest large block, in bytes. */
+
+static char *blocks[LARGE_CNT > SLOTS ? LARGE_CNT : SLOTS];
+static size_t sizes[LARGE_CNT > SLOTS ? LARGE_CNT : SLOTS];
+
+/* Allocates a block of SIZE bytes, filled with a pattern based
+   on SIZE, into slot I. */
+static void
+fill_slot (int i, size_t size)
+{
+  blocks[i] = malloc (size);
+  if (blocks[i] == NULL)
+    {
+      printf ("mallocbench: out of memory allocating %zu bytes\n", size);
+      exit (1);
+    }
+  sizes[i] = size;
+  memset (blocks[i], size & 0xff, size);
+}
+
+/* Checks and frees the block in slot I. */
+static void
+empty_slot (int i)
+{
+  size_t j;
+
+  if (blocks[i] == NULL)
+    return;
+  for (j = 0; j < sizes[i]; j++)
+    if ((unsigned char) blocks[i][j] != (sizes[i] & 0xff))
+      {
+        printf ("mallocbench: block of %zu bytes corrupted\n", sizes[i]);
+        exit (1);
+      }
+  free (blocks[i]);
+  blocks[i] = NULL;
+}
+
+/* Replaces random small blocks. */
+static long
+small_blocks (void)
+{
+  long ops = 0;
+  int i;
+
+  for (i = 0; i < SLOTS * 16; i++)
+    {
+      int slot = random_ulong () % SLOTS;
+      empty_slot (slot);
+      fill_slot (slot, random_ulong () % SMALL_MAX + 1);
+      ops += 2;
+    }
+  for (i = 0; i < SLOTS; i++)
+    empty_slot (i);
+  return ops;
+}
+
+/* Grows an array one element at a time. */
+static long
+growing_array (void)
+{
+  int *array = NULL;
+  int i;
+
+  for (i = 0; i < ARRAY_LEN; i++)
+    {
+      array = realloc (array, (i + 1) * sizeof *array);
+      if (array == NULL)
+        {
+          printf ("mallocbench: out of memory growing array\n");
+          exit (1);
+        }
+      array[i] = i;
+    }
+  for (i = 0; i < ARRAY_LEN; i++)
+    if (array[i] != i)
+      {
+        printf ("mallocbench: array corrupted at %d\n", i);
+        exit (1);
+      }
+  free (array);
+  return ARRAY_LEN + 1;
+}
+
+/* Allocates large blocks and frees them in random order. */
+static long
+large_blocks (void)
+{
+  int order[LARGE_CNT];
+  int i;
+
+  for (i = 0; i < LARGE_CNT; i++)
+    {
+      int j = random_ulong () % (i + 1);
+
+      fill_slot (i, random_ulong () % LARGE_MAX + SMALL_MAX + 1);
+      order[i] = order[j];
+      order[j] = i;
+    }
+  for (i = 0; i < LARGE_CNT; i++)
+    empty_slot (order[i]);
+  return 2 * LARGE_CNT;
+}
+
+int
+main (int argc, char *argv[])
+{
+  struct memstat ms;
+  long ops = 0;
+  int rounds, i;
+
+  rounds = argc == 2 ? atoi (argv[1]) : 0;
+  if (rounds < 1)
+    {
+      printf ("usage: mallocbench <rounds>\n");
+      return EXIT_FAILURE;
+    }
+
+  random_init (0);
+  for (i = 0; i < rounds; i++)
+    ops += small_blocks () + growing_array () + large_blocks ();
+
+  printf ("mallocbench: %ld allocations and frees\n", ops);
+  if (memstat (&ms))
+    printf ("mallocbench: peak of %zu pages resident, %lld page faults\n",
+            ms.peak_resident_pages, ms.minor_faults + ms.major_faults);
+  return EXIT_SUCCESS;
+}
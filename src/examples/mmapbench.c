@@ -0,0 +1,128 @@
+/* mmapbench.c
+
+   Benchmark that scans a file sequentially, either by read()ing
+   it into a buffer or by mapping it with mmap() and reading the
+   mapping in place.
+
+   Creates a scratch file of the given size in kB, then sums its
+   bytes ROUNDS times over.  A read() scan copies every byte
+   through the kernel once per round; a mapped scan takes one
+   page fault per page on the first round and reads straight out
+   of the page cache after that.
+
+   Compare the tick counts printed at shutdown for the two modes,
+   e.g.:
+
+      pintos -p mmapbench -a mmapbench -- -q run 'mmapbench read 64 8'
+      pintos -p mmapbench -a mmapbench -- -q run 'mmapbench mmap 64 8'
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syscall.h>
+
+#define FILE_NAME "mmapbench.dat"
+#define MAX_KB 1024
+
+/* Where the file is mapped. */
+#define MAP_ADDR ((char *) 0x10000000)
+
+static char buffer[4096];
+
+/* Fills FILE_NAME with SIZE bytes of a known pattern. */
+static void
+fill_file (int size)
+{
+  int fd, i;
+
+  if (!create (FILE_NAME, size))
+    {
+      printf ("mmapbench: cannot create %s\n", FILE_NAME);
+      exit (1);
+    }
+  fd = open (FILE_NAME);
+  if (fd < 0)
+    {
+      printf ("mmapbench: cannot open %s\n", FILE_NAME);
+      exit (1);
+    }
+  for (i = 0; i < (int) sizeof buffer; i++)
+    buffer[i] = i * 7;
+  for (i = 0; i < size; i += sizeof buffer)
+    write (fd, buffer, sizeof buffer);
+  close (fd);
+}
+
+/* Sums the bytes of FD ROUNDS times over with read(). */
+static unsigned
+scan_read (int fd, int rounds)
+{
+  unsigned sum = 0;
+  int i, n, j;
+
+  for (i = 0; i < rounds; i++)
+    {
+      seek (fd, 0);
+      while ((n = read (fd, buffer, sizeof buffer)) > 0)
+        for (j = 0; j < n; j++)
+          sum += (unsigned char) buffer[j];
+    }
+  return sum;
+}
+
+/* Sums the SIZE bytes of FD ROUNDS times over through a
+   mapping. */
+static unsigned
+scan_mmap (int fd, int size, int rounds)
+{
+  unsigned sum = 0;
+  mapid_t map;
+  int i, j;
+
+  map = mmap (fd, MAP_ADDR);
+  if (map == MAP_FAILED)
+    {
+      printf ("mmapbench: mmap failed\n");
+      exit (1);
+    }
+  for (i = 0; i < rounds; i++)
+    for (j = 0; j < size; j++)
+      sum += (unsigned char) MAP_ADDR[j];
+  munmap (map);
+  return sum;
+}
+
+int
+main (int argc, char *argv[])
+{
+  unsigned sum;
+  int kb, rounds, fd;
+  bool use_mmap;
+
+  kb = argc == 4 ? atoi (argv[2]) : 0;
+  rounds = argc == 4 ? atoi (argv[3]) : 0;
+  if (argc != 4 || (strcmp (argv[1], "read") && strcmp (argv[1], "mmap"))
+      || kb < 4 || kb > MAX_KB || kb % 4 != 0 || rounds < 1)
+    {
+      printf ("usage: mmapbench read|mmap <kB, multiple of 4> <rounds>\n");
+      return EXIT_FAILURE;
+    }
+  use_mmap = !strcmp (argv[1], "mmap");
+
+  fill_file (kb * 1024);
+  fd = open (FILE_NAME);
+  if (fd < 0)
+    {
+      printf ("mmapbench: cannot open %s\n", FILE_NAME);
+      return EXIT_FAILURE;
+    }
+  sum = (use_mmap
+         ? scan_mmap (fd, kb * 1024, rounds)
+         : scan_read (fd, rounds));
+  close (fd);
+
+  printf ("mmapbench: %s scanned %d kB %d times, sum %u\n",
+          argv[1], kb, rounds, sum);
+  return EXIT_SUCCESS;
+}
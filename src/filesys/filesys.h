@@ -3,6 +3,7 @@
 
 #include <stdbool.h>
 #include "filesys/off_t.h"
+#include "threads/synch.h"
 
 /* Sectors of system file inodes. */
 #define FREE_MAP_SECTOR 0       /* Free map file inode sector. */
@@ -11,6 +12,15 @@
 /* Block device that contains the file system. */
 struct block *fs_device;
 
+/* Serializes file system operations: the free map, directories,
+   opening and closing inodes, and file positions are not safe to
+   use from more than one thread at a time.  Callers that act for
+   user processes hold it around each call into the file system.
+   Reading and writing file data does not need it (see inode.c),
+   so page faults, the page cache and the VM write-back paths
+   never take it, and a page fault while holding it is safe. */
+extern struct lock filesys_lock;
+
 void filesys_init (bool format);
 void filesys_done (void);
 bool filesys_create (const char *name, off_t initial_size);
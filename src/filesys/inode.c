@@ -6,6 +6,13 @@
 #include "filesys/filesys.h"
 #include "filesys/free-map.h"
 #include "threads/malloc.h"
+#include "threads/slab.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+#ifdef VM
+#include <radix.h>
+#include "vm/frame.h"
+#endif
 
 /* Identifies an inode. */
 #define INODE_MAGIC 0x494e4f44
@@ -37,6 +44,11 @@ struct inode
     bool removed;                       /* True if deleted, false otherwise. */
     int deny_write_cnt;                 /* 0: writes ok, >0: deny writes. */
     struct inode_disk data;             /* Inode content. */
+    struct lock lock;                   /* Serializes data reads, writes. */
+#ifdef VM
+    struct radix_tree pages;            /* Page cache, see vm/frame.c. */
+    int write_map_cnt;                  /* Writable memory mappings. */
+#endif
   };
 
 /* Returns the block device sector that contains byte offset POS
@@ -54,14 +66,35 @@ byte_to_sector (const struct inode *inode, off_t pos)
 }
 
 /* List of open inodes, so that opening a single inode twice
-   returns the same `struct inode'. */
+   returns the same `struct inode'.
+
+   With VM, file data is read through the page cache, and an
+   inode stays on this list after it is closed for as long as the
+   cache holds pages of it, so that opening the file again finds
+   them.  Such an idle inode is freed when the cache drops its
+   last page, through inode_uncache_page().
+
+   OPEN_INODES_LOCK protects the list, every inode's OPEN_CNT and
+   removals from its page tree.  The page cache takes it with the
+   frame lock held, so nothing may acquire the frame lock, or
+   sleep on the disk, while holding it. */
 static struct list open_inodes;
+static struct lock open_inodes_lock;
+
+static bool inode_cached (struct inode *);
+static void free_inode (struct inode *);
+
+/* Cache of `struct inode's. */
+static struct slab_cache inode_cache;
 
 /* Initializes the inode module. */
 void
 inode_init (void) 
 {
   list_init (&open_inodes);
+  lock_init (&open_inodes_lock);
+  slab_cache_init (&inode_cache, "inode", sizeof (struct inode),
+                   __alignof__ (struct inode), NULL);
 }
 
 /* Initializes an inode with LENGTH bytes of data and
@@ -115,29 +148,41 @@ inode_open (block_sector_t sector)
   struct inode *inode;
 
   /* Check whether this inode is already open. */
+  lock_acquire (&open_inodes_lock);
   for (e = list_begin (&open_inodes); e != list_end (&open_inodes);
        e = list_next (e)) 
     {
       inode = list_entry (e, struct inode, elem);
       if (inode->sector == sector) 
         {
-          inode_reopen (inode);
+          inode->open_cnt++;
+          lock_release (&open_inodes_lock);
           return inode; 
         }
     }
+  lock_release (&open_inodes_lock);
 
   /* Allocate memory. */
-  inode = malloc (sizeof *inode);
+  inode = slab_alloc (&inode_cache);
   if (inode == NULL)
     return NULL;
 
-  /* Initialize. */
-  list_push_front (&open_inodes, &inode->elem);
+  /* Initialize.  The file system lock keeps anyone else from
+     opening the same inode meanwhile. */
   inode->sector = sector;
   inode->open_cnt = 1;
   inode->deny_write_cnt = 0;
   inode->removed = false;
+  lock_init (&inode->lock);
+#ifdef VM
+  radix_init (&inode->pages);
+  inode->write_map_cnt = 0;
+#endif
   block_read (fs_device, inode->sector, &inode->data);
+
+  lock_acquire (&open_inodes_lock);
+  list_push_front (&open_inodes, &inode->elem);
+  lock_release (&open_inodes_lock);
   return inode;
 }
 
@@ -146,7 +191,11 @@ struct inode *
 inode_reopen (struct inode *inode)
 {
   if (inode != NULL)
-    inode->open_cnt++;
+    {
+      lock_acquire (&open_inodes_lock);
+      inode->open_cnt++;
+      lock_release (&open_inodes_lock);
+    }
   return inode;
 }
 
@@ -167,22 +216,50 @@ inode_close (struct inode *inode)
   if (inode == NULL)
     return;
 
-  /* Release resources if this was the last opener. */
-  if (--inode->open_cnt == 0)
+  /* Deallocate blocks if removed and this is the last opener.
+     It stays open meanwhile, so dropping its pages from the page
+     cache does not free it. */
+  lock_acquire (&open_inodes_lock);
+  if (inode->open_cnt == 1 && inode->removed) 
     {
-      /* Remove from inode list and release lock. */
-      list_remove (&inode->elem);
- 
-      /* Deallocate blocks if removed. */
-      if (inode->removed) 
-        {
-          free_map_release (inode->sector, 1);
-          free_map_release (inode->data.start,
-                            bytes_to_sectors (inode->data.length)); 
-        }
-
-      free (inode); 
+      lock_release (&open_inodes_lock);
+#ifdef VM
+      frame_cache_flush (inode);
+#endif
+      free_map_release (inode->sector, 1);
+      free_map_release (inode->data.start,
+                        bytes_to_sectors (inode->data.length)); 
+      lock_acquire (&open_inodes_lock);
     }
+
+  /* Release resources if this was the last opener, unless the
+     page cache still holds pages of it. */
+  if (--inode->open_cnt == 0 && !inode_cached (inode))
+    free_inode (inode);
+  lock_release (&open_inodes_lock);
+}
+
+/* Returns true if the page cache holds pages of INODE. */
+static bool
+inode_cached (struct inode *inode UNUSED)
+{
+#ifdef VM
+  return !radix_empty (&inode->pages);
+#else
+  return false;
+#endif
+}
+
+/* Removes INODE, which nobody has open, from the inode list and
+   frees it. */
+static void
+free_inode (struct inode *inode)
+{
+  ASSERT (lock_held_by_current_thread (&open_inodes_lock));
+  ASSERT (inode->open_cnt == 0);
+
+  list_remove (&inode->elem);
+  slab_free (&inode_cache, inode);
 }
 
 /* Marks INODE to be deleted when it is closed by the last caller who
@@ -199,11 +276,154 @@ inode_remove (struct inode *inode)
    than SIZE if an error occurs or end of file is reached. */
 off_t
 inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset) 
+{
+#ifdef VM
+  uint8_t *buffer = buffer_;
+  off_t bytes_read = 0;
+
+  /* Copy out of the page cache, a page at a time. */
+  while (size > 0)
+    {
+      size_t page_idx = offset / PGSIZE;
+      int page_ofs = offset % PGSIZE;
+      off_t inode_left = inode_length (inode) - offset;
+      int page_left = PGSIZE - page_ofs;
+      int min_left = inode_left < page_left ? inode_left : page_left;
+      int chunk_size = size < min_left ? size : min_left;
+      struct frame *f;
+
+      if (chunk_size <= 0)
+        break;
+
+      f = frame_cache_get (inode, page_idx, NULL);
+      if (f != NULL)
+        {
+          memcpy (buffer + bytes_read, (uint8_t *) f->kpage + page_ofs,
+                  chunk_size);
+          frame_unpin (f);
+        }
+      else if (inode_read_uncached (inode, buffer + bytes_read, chunk_size,
+                                    offset) != chunk_size)
+        break;
+
+      size -= chunk_size;
+      offset += chunk_size;
+      bytes_read += chunk_size;
+    }
+  return bytes_read;
+#else
+  return inode_read_uncached (inode, buffer_, size, offset);
+#endif
+}
+
+/* Writes SIZE bytes from BUFFER into INODE, starting at OFFSET.
+   Returns the number of bytes actually written, which may be
+   less than SIZE if end of file is reached or an error occurs.
+   (Normally a write at end of file would extend the inode, but
+   growth is not yet implemented.)
+
+   The data goes straight to disk.  With VM, any page of it in the
+   page cache is updated too. */
+off_t
+inode_write_at (struct inode *inode, const void *buffer_, off_t size,
+                off_t offset) 
+{
+  off_t bytes_written = inode_write_uncached (inode, buffer_, size, offset);
+#ifdef VM
+  const uint8_t *buffer = buffer_;
+  off_t done = 0;
+
+  while (done < bytes_written)
+    {
+      off_t pos = offset + done;
+      int page_ofs = pos % PGSIZE;
+      int chunk_size = PGSIZE - page_ofs;
+
+      if (chunk_size > bytes_written - done)
+        chunk_size = bytes_written - done;
+      frame_cache_update (inode, pos / PGSIZE, page_ofs, buffer + done,
+                          chunk_size);
+      done += chunk_size;
+    }
+#endif
+  return bytes_written;
+}
+
+#ifdef VM
+/* Returns the tree of INODE's pages in the page cache.  Only
+   the page cache may change it, with the frame lock held, and
+   it must remove pages through inode_uncache_page(). */
+struct radix_tree *
+inode_page_tree (struct inode *inode)
+{
+  return &inode->pages;
+}
+
+/* Removes page PAGE_IDX from INODE's page tree.  If that was its
+   last cached page and nobody has INODE open, frees INODE. */
+void
+inode_uncache_page (struct inode *inode, size_t page_idx)
+{
+  lock_acquire (&open_inodes_lock);
+  radix_delete (&inode->pages, page_idx);
+  if (inode->open_cnt == 0 && !inode_cached (inode))
+    free_inode (inode);
+  lock_release (&open_inodes_lock);
+}
+
+/* Records a writable memory mapping of INODE.  A mapping writes
+   straight into the page cache, which the code of a running
+   executable is mapped from, so this fails, recording nothing,
+   if writes to INODE are denied.  Returns true if successful. */
+bool
+inode_map_writable (struct inode *inode)
+{
+  if (inode->deny_write_cnt > 0)
+    return false;
+  inode->write_map_cnt++;
+  return true;
+}
+
+/* Drops a mapping recorded by inode_map_writable(). */
+void
+inode_unmap_writable (struct inode *inode)
+{
+  ASSERT (inode->write_map_cnt > 0);
+  inode->write_map_cnt--;
+}
+
+/* Returns true if INODE has writable memory mappings, so that it
+   must not be run as an executable. */
+bool
+inode_mapped_writable (const struct inode *inode)
+{
+  return inode->write_map_cnt > 0;
+}
+#endif
+
+/* Reads SIZE bytes from INODE into BUFFER, starting at position
+   OFFSET, straight from disk.  Returns the number of bytes
+   actually read, which may be less than SIZE if an error occurs
+   or end of file is reached.
+
+   A file's sectors never move, so reading and writing its data
+   needs no more than INODE's own lock, which keeps a read from
+   seeing a write half done and two writes to parts of one sector
+   from losing each other's bytes.  The VM write-back paths call
+   this and inode_write_uncached() without the file system lock.
+   BUFFER must not be in user memory: a page fault with INODE's
+   lock held could need to write back a page of the same file. */
+off_t
+inode_read_uncached (struct inode *inode, void *buffer_, off_t size,
+                     off_t offset)
 {
   uint8_t *buffer = buffer_;
   off_t bytes_read = 0;
   uint8_t *bounce = NULL;
 
+  ASSERT (!is_user_vaddr (buffer));
+
+  lock_acquire (&inode->lock);
   while (size > 0) 
     {
       /* Disk sector to read, starting byte offset within sector. */
@@ -244,26 +464,33 @@ inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset)
       offset += chunk_size;
       bytes_read += chunk_size;
     }
+  lock_release (&inode->lock);
   free (bounce);
 
   return bytes_read;
 }
 
-/* Writes SIZE bytes from BUFFER into INODE, starting at OFFSET.
-   Returns the number of bytes actually written, which may be
-   less than SIZE if end of file is reached or an error occurs.
-   (Normally a write at end of file would extend the inode, but
-   growth is not yet implemented.) */
+/* Writes SIZE bytes from BUFFER into INODE, starting at OFFSET,
+   straight to disk, bypassing the page cache.  Returns the number
+   of bytes actually written, which may be less than SIZE if end
+   of file is reached or an error occurs.  As with
+   inode_read_uncached(), BUFFER must not be in user memory. */
 off_t
-inode_write_at (struct inode *inode, const void *buffer_, off_t size,
-                off_t offset) 
+inode_write_uncached (struct inode *inode, const void *buffer_, off_t size,
+                      off_t offset)
 {
   const uint8_t *buffer = buffer_;
   off_t bytes_written = 0;
   uint8_t *bounce = NULL;
 
+  ASSERT (!is_user_vaddr (buffer));
+
+  lock_acquire (&inode->lock);
   if (inode->deny_write_cnt)
-    return 0;
+    {
+      lock_release (&inode->lock);
+      return 0;
+    }
 
   while (size > 0) 
     {
@@ -312,6 +539,7 @@ inode_write_at (struct inode *inode, const void *buffer_, off_t size,
       offset += chunk_size;
       bytes_written += chunk_size;
     }
+  lock_release (&inode->lock);
   free (bounce);
 
   return bytes_written;
@@ -2,10 +2,12 @@
 #define FILESYS_INODE_H
 
 #include <stdbool.h>
+#include <stddef.h>
 #include "filesys/off_t.h"
 #include "devices/block.h"
 
 struct bitmap;
+struct radix_tree;
 
 void inode_init (void);
 bool inode_create (block_sector_t, off_t);
@@ -16,6 +18,16 @@ void inode_close (struct inode *);
 void inode_remove (struct inode *);
 off_t inode_read_at (struct inode *, void *, off_t size, off_t offset);
 off_t inode_write_at (struct inode *, const void *, off_t size, off_t offset);
+off_t inode_read_uncached (struct inode *, void *, off_t size, off_t offset);
+off_t inode_write_uncached (struct inode *, const void *, off_t size,
+                            off_t offset);
+#ifdef VM
+struct radix_tree *inode_page_tree (struct inode *);
+void inode_uncache_page (struct inode *, size_t page_idx);
+bool inode_map_writable (struct inode *);
+void inode_unmap_writable (struct inode *);
+bool inode_mapped_writable (const struct inode *);
+#endif
 void inode_deny_write (struct inode *);
 void inode_allow_write (struct inode *);
 off_t inode_length (const struct inode *);
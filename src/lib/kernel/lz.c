@@ -0,0 +1,202 @@
+/* LZ compression.
+
+   See lz.h for basic information. */
+
+#include "lz.h"
+#include <stdint.h>
+#include <string.h>
+#include "../debug.h"
+
+/* Largest value of a 4-bit token field. */
+#define FIELD_MAX 15
+
+/* Output buffer being filled by lz_compress(). */
+struct out
+  {
+    uint8_t *p;                 /* Next byte to write. */
+    uint8_t *end;               /* End of the buffer. */
+  };
+
+static unsigned hash (const uint8_t *);
+static bool put_sequence (struct out *, const uint8_t *lits, size_t lit_cnt,
+                          size_t dist, size_t match_len);
+static bool put_count (struct out *, size_t cnt);
+
+/* Compresses the SRC_SIZE bytes at SRC, which may be at most
+   LZ_MAX_INPUT, into the DST_SIZE bytes at DST.  WORK must point
+   to LZ_WORK_SIZE bytes of scratch memory.  Returns the number
+   of bytes written to DST, or 0 if the compressed data does not
+   fit in DST_SIZE bytes. */
+size_t
+lz_compress (const void *src_, size_t src_size,
+             void *dst, size_t dst_size, void *work)
+{
+  const uint8_t *src = src_;
+  unsigned short *table = work;
+  struct out out;
+  size_t pos, anchor;
+
+  ASSERT (src_size <= LZ_MAX_INPUT);
+
+  /* TABLE maps the hash of LZ_MIN_MATCH bytes to 1 + the
+     position where they were last seen, or 0 for none. */
+  memset (table, 0, LZ_WORK_SIZE);
+  out.p = dst;
+  out.end = out.p + dst_size;
+
+  pos = anchor = 0;
+  while (pos + LZ_MIN_MATCH <= src_size)
+    {
+      unsigned h = hash (src + pos);
+      size_t ref = table[h];
+
+      table[h] = pos + 1;
+      if (ref != 0 && !memcmp (src + ref - 1, src + pos, LZ_MIN_MATCH))
+        {
+          size_t len = LZ_MIN_MATCH;
+
+          ref--;
+          while (pos + len < src_size && src[ref + len] == src[pos + len])
+            len++;
+          if (!put_sequence (&out, src + anchor, pos - anchor,
+                             pos - ref, len))
+            return 0;
+          pos += len;
+          anchor = pos;
+        }
+      else
+        pos++;
+    }
+
+  if (anchor < src_size
+      && !put_sequence (&out, src + anchor, src_size - anchor, 0, 0))
+    return 0;
+  return out.p - (uint8_t *) dst;
+}
+
+/* Decompresses the SRC_SIZE bytes at SRC, which must decompress
+   to exactly DST_SIZE bytes, into DST.  Returns true if
+   successful, false if SRC is not valid compressed data of that
+   size. */
+bool
+lz_decompress (const void *src_, size_t src_size,
+               void *dst_, size_t dst_size)
+{
+  const uint8_t *src = src_;
+  const uint8_t *src_end = src + src_size;
+  uint8_t *dst = dst_;
+  uint8_t *dst_end = dst + dst_size;
+  uint8_t *p = dst;
+
+  while (src < src_end)
+    {
+      unsigned token = *src++;
+      size_t lit_cnt = token >> 4;
+      size_t len = token & FIELD_MAX;
+      size_t dist;
+      unsigned b;
+
+      /* Literals. */
+      if (lit_cnt == FIELD_MAX)
+        do
+          {
+            if (src >= src_end)
+              return false;
+            b = *src++;
+            lit_cnt += b;
+          }
+        while (b == 255);
+      if (lit_cnt > (size_t) (src_end - src)
+          || lit_cnt > (size_t) (dst_end - p))
+        return false;
+      memcpy (p, src, lit_cnt);
+      src += lit_cnt;
+      p += lit_cnt;
+      if (src == src_end)
+        break;
+
+      /* Copy. */
+      if (src_end - src < 2)
+        return false;
+      dist = src[0] | (src[1] << 8);
+      src += 2;
+      if (len == FIELD_MAX)
+        do
+          {
+            if (src >= src_end)
+              return false;
+            b = *src++;
+            len += b;
+          }
+        while (b == 255);
+      len += LZ_MIN_MATCH;
+      if (dist == 0 || dist > (size_t) (p - dst)
+          || len > (size_t) (dst_end - p))
+        return false;
+
+      /* The copy may overlap its own output, so go a byte at a
+         time. */
+      for (; len > 0; len--, p++)
+        *p = p[-dist];
+    }
+  return p == dst_end;
+}
+
+/* Returns a hash of the LZ_MIN_MATCH bytes at P. */
+static unsigned
+hash (const uint8_t *p)
+{
+  uint32_t v;
+
+  memcpy (&v, p, sizeof v);
+  return (v * 2654435761u) >> (32 - LZ_HASH_BITS);
+}
+
+/* Writes a sequence of the LIT_CNT bytes at LITS followed by a
+   copy of MATCH_LEN bytes from DIST bytes back, or by no copy if
+   MATCH_LEN is 0.  Returns false if OUT runs out of room. */
+static bool
+put_sequence (struct out *out, const uint8_t *lits, size_t lit_cnt,
+              size_t dist, size_t match_len)
+{
+  size_t len = match_len > 0 ? match_len - LZ_MIN_MATCH : 0;
+  unsigned lit_field = lit_cnt < FIELD_MAX ? lit_cnt : FIELD_MAX;
+  unsigned len_field = len < FIELD_MAX ? len : FIELD_MAX;
+
+  if (out->p >= out->end)
+    return false;
+  *out->p++ = (lit_field << 4) | len_field;
+  if (lit_field == FIELD_MAX && !put_count (out, lit_cnt - FIELD_MAX))
+    return false;
+  if (lit_cnt > (size_t) (out->end - out->p))
+    return false;
+  memcpy (out->p, lits, lit_cnt);
+  out->p += lit_cnt;
+
+  if (match_len == 0)
+    return true;
+  if (out->end - out->p < 2)
+    return false;
+  *out->p++ = dist & 0xff;
+  *out->p++ = dist >> 8;
+  return len_field < FIELD_MAX || put_count (out, len - FIELD_MAX);
+}
+
+/* Writes the continuation of a token field, CNT more than
+   FIELD_MAX, to OUT.  Returns false if OUT runs out of room. */
+static bool
+put_count (struct out *out, size_t cnt)
+{
+  for (;;)
+    {
+      if (out->p >= out->end)
+        return false;
+      if (cnt < 255)
+        {
+          *out->p++ = cnt;
+          return true;
+        }
+      *out->p++ = 255;
+      cnt -= 255;
+    }
+}
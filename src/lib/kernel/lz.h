@@ -0,0 +1,47 @@
+#ifndef __LIB_KERNEL_LZ_H
+#define __LIB_KERNEL_LZ_H
+
+/* LZ compression.
+
+   A fast, byte-oriented LZ77 codec in the style of LZ4, meant
+   for data such as memory pages that is compressed and
+   decompressed often and must not cost much either way.  It
+   finds matches through a small hash table of recent positions
+   rather than searching, so it compresses less than codecs that
+   search, but runs in a single pass.
+
+   The compressed data is a series of sequences, each a run of
+   literal bytes followed by a copy of earlier output:
+
+      - A token byte: the literal count in its high 4 bits and
+        the copy length minus LZ_MIN_MATCH in its low 4 bits.  A
+        field of 15 continues in the bytes that follow, each
+        added to it, until one that is not 255.
+
+      - The literal bytes.
+
+      - The distance back to the start of the copy, 2 bytes,
+        least significant first, then any continuation of the
+        copy length.
+
+   The last sequence ends after its literals, with no copy. */
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/* Shortest copy encoded. */
+#define LZ_MIN_MATCH 4
+
+/* Longest input lz_compress() accepts. */
+#define LZ_MAX_INPUT 65535
+
+/* Bytes of scratch memory lz_compress() needs. */
+#define LZ_HASH_BITS 10
+#define LZ_WORK_SIZE ((1u << LZ_HASH_BITS) * sizeof (unsigned short))
+
+size_t lz_compress (const void *src, size_t src_size,
+                    void *dst, size_t dst_size, void *work);
+bool lz_decompress (const void *src, size_t src_size,
+                    void *dst, size_t dst_size);
+
+#endif /* lib/kernel/lz.h */
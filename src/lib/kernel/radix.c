@@ -0,0 +1,252 @@
+/* Radix tree.
+
+   See radix.h for basic information. */
+
+#include "radix.h"
+#include <limits.h>
+#include <string.h>
+#include "../debug.h"
+#include "threads/malloc.h"
+
+/* Most levels a tree can need: enough to cover every bit of a
+   size_t. */
+#define RADIX_MAX_HEIGHT \
+        ((sizeof (size_t) * CHAR_BIT + RADIX_BITS - 1) / RADIX_BITS)
+
+/* Interior node.  At the lowest level, the slots hold the
+   values; above it, they hold the nodes one level down. */
+struct radix_node
+  {
+    void *slots[RADIX_SLOTS];   /* Values or child nodes. */
+    unsigned cnt;               /* Number of non-null slots. */
+  };
+
+static struct radix_node *new_node (void);
+static void undo_insert (struct radix_tree *, size_t key,
+                         unsigned old_height);
+static bool fits (unsigned height, size_t key);
+static unsigned slot_idx (size_t key, unsigned level);
+
+/* Initializes T as an empty radix tree. */
+void
+radix_init (struct radix_tree *t)
+{
+  t->root = NULL;
+  t->height = 0;
+  t->cnt = 0;
+}
+
+/* Returns the value stored in T under KEY, or a null pointer if
+   there is none. */
+void *
+radix_lookup (const struct radix_tree *t, size_t key)
+{
+  struct radix_node *node = t->root;
+  unsigned level;
+
+  if (!fits (t->height, key))
+    return NULL;
+
+  for (level = t->height - 1; node != NULL && level > 0; level--)
+    node = node->slots[slot_idx (key, level)];
+  return node != NULL ? node->slots[slot_idx (key, 0)] : NULL;
+}
+
+/* Stores non-null VALUE in T under KEY, which must not be in use.
+   Returns true if successful, false if memory allocation
+   fails, in which case T is left as it was. */
+bool
+radix_insert (struct radix_tree *t, size_t key, void *value)
+{
+  struct radix_node *node;
+  unsigned old_height;
+  unsigned level;
+
+  ASSERT (value != NULL);
+
+  /* Add levels at the top until KEY fits. */
+  if (t->root == NULL)
+    t->height = 0;
+  old_height = t->height;
+  while (t->height == 0 || !fits (t->height, key))
+    {
+      if (t->root != NULL)
+        {
+          struct radix_node *root = new_node ();
+          if (root == NULL)
+            goto fail;
+          root->slots[0] = t->root;
+          root->cnt = 1;
+          t->root = root;
+        }
+      t->height++;
+    }
+  if (t->root == NULL)
+    {
+      t->root = new_node ();
+      if (t->root == NULL)
+        goto fail;
+    }
+
+  /* Walk down, adding nodes where missing. */
+  node = t->root;
+  for (level = t->height - 1; level > 0; level--)
+    {
+      void **slot = &node->slots[slot_idx (key, level)];
+      if (*slot == NULL)
+        {
+          *slot = new_node ();
+          if (*slot == NULL)
+            goto fail;
+          node->cnt++;
+        }
+      node = *slot;
+    }
+
+  ASSERT (node->slots[slot_idx (key, 0)] == NULL);
+  node->slots[slot_idx (key, 0)] = value;
+  node->cnt++;
+  t->cnt++;
+  return true;
+
+ fail:
+  undo_insert (t, key, old_height);
+  return false;
+}
+
+/* Removes the value stored in T under KEY and returns it, or
+   returns a null pointer if there is none.  Frees the nodes
+   left empty. */
+void *
+radix_delete (struct radix_tree *t, size_t key)
+{
+  struct radix_node *path[RADIX_MAX_HEIGHT];
+  struct radix_node *node = t->root;
+  unsigned level;
+  void *value;
+
+  if (!fits (t->height, key))
+    return NULL;
+
+  for (level = t->height - 1; ; level--)
+    {
+      if (node == NULL)
+        return NULL;
+      path[level] = node;
+      if (level == 0)
+        break;
+      node = node->slots[slot_idx (key, level)];
+    }
+
+  value = node->slots[slot_idx (key, 0)];
+  if (value == NULL)
+    return NULL;
+  t->cnt--;
+
+  /* Clear the slot, then free the nodes it leaves empty. */
+  for (level = 0; level < t->height; level++)
+    {
+      node = path[level];
+      node->slots[slot_idx (key, level)] = NULL;
+      if (--node->cnt > 0)
+        break;
+      free (node);
+    }
+  if (level == t->height)
+    {
+      t->root = NULL;
+      t->height = 0;
+    }
+  return value;
+}
+
+/* Returns the number of entries in T. */
+size_t
+radix_size (const struct radix_tree *t)
+{
+  return t->cnt;
+}
+
+/* Returns true if T has no entries, false otherwise. */
+bool
+radix_empty (const struct radix_tree *t)
+{
+  return t->cnt == 0;
+}
+
+/* Returns a new node with every slot empty, or a null pointer if
+   memory allocation fails. */
+static struct radix_node *
+new_node (void)
+{
+  struct radix_node *node = malloc (sizeof *node);
+  if (node != NULL)
+    {
+      memset (node->slots, 0, sizeof node->slots);
+      node->cnt = 0;
+    }
+  return node;
+}
+
+/* Undoes a radix_insert() of KEY into T, which was OLD_HEIGHT
+   levels tall, that failed partway: frees the nodes it added on
+   KEY's path, which are still empty, then the levels it added at
+   the top. */
+static void
+undo_insert (struct radix_tree *t, size_t key, unsigned old_height)
+{
+  struct radix_node *path[RADIX_MAX_HEIGHT];
+  struct radix_node *node = t->root;
+  unsigned depth = 0;
+  unsigned level;
+
+  /* PATH[I] is the node on KEY's path at level HEIGHT - 1 - I. */
+  for (level = t->height; node != NULL && level > 0; level--)
+    {
+      path[depth++] = node;
+      node = level > 1 ? node->slots[slot_idx (key, level - 1)] : NULL;
+    }
+
+  while (depth > 0 && path[depth - 1]->cnt == 0)
+    {
+      free (path[--depth]);
+      if (depth > 0)
+        {
+          path[depth - 1]->slots[slot_idx (key, t->height - depth)] = NULL;
+          path[depth - 1]->cnt--;
+        }
+      else
+        t->root = NULL;
+    }
+
+  if (t->root == NULL)
+    t->height = 0;
+  else
+    while (t->height > old_height)
+      {
+        struct radix_node *root = t->root;
+        ASSERT (root->cnt == 1 && root->slots[0] != NULL);
+        t->root = root->slots[0];
+        t->height--;
+        free (root);
+      }
+}
+
+/* Returns true if a tree HEIGHT levels tall has room for KEY. */
+static bool
+fits (unsigned height, size_t key)
+{
+  if (height == 0)
+    return false;
+  if (height * RADIX_BITS >= sizeof (size_t) * CHAR_BIT)
+    return true;
+  return key >> (height * RADIX_BITS) == 0;
+}
+
+/* Returns the slot that KEY falls in at LEVEL, counting from 0
+   at the bottom. */
+static unsigned
+slot_idx (size_t key, unsigned level)
+{
+  return (key >> (level * RADIX_BITS)) & (RADIX_SLOTS - 1);
+}
@@ -0,0 +1,38 @@
+#ifndef __LIB_KERNEL_RADIX_H
+#define __LIB_KERNEL_RADIX_H
+
+/* Radix tree.
+
+   Maps keys of type size_t to non-null pointers.  Each interior
+   node has RADIX_SLOTS slots, indexed by RADIX_BITS bits of the
+   key, most significant bits at the root, so a lookup takes one
+   step per level and the tree is only as tall as the largest key
+   requires.  This suits dense keys that start near 0, such as
+   page numbers within a file.
+
+   Unlike the list and hash table, the tree allocates its own
+   nodes, so radix_insert() can fail. */
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/* Bits of the key used at each level. */
+#define RADIX_BITS 6
+#define RADIX_SLOTS (1u << RADIX_BITS)
+
+/* Radix tree. */
+struct radix_tree
+  {
+    struct radix_node *root;    /* Root node, or null if empty. */
+    unsigned height;            /* Number of levels of nodes. */
+    size_t cnt;                 /* Number of entries. */
+  };
+
+void radix_init (struct radix_tree *);
+void *radix_lookup (const struct radix_tree *, size_t key);
+bool radix_insert (struct radix_tree *, size_t key, void *value);
+void *radix_delete (struct radix_tree *, size_t key);
+size_t radix_size (const struct radix_tree *);
+bool radix_empty (const struct radix_tree *);
+
+#endif /* lib/kernel/radix.h */
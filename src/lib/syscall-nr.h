@@ -26,6 +26,9 @@ enum
     /* Project 3 and optionally project 4. */
     SYS_MMAP,                   /* Map a file into memory. */
     SYS_MUNMAP,                 /* Remove a memory mapping. */
+    SYS_FORK,                   /* Clone this process. */
+    SYS_SBRK,                   /* Move the end of the heap. */
+    SYS_MEMSTAT,                /* Report memory usage. */
 
     /* Project 4 only. */
     SYS_CHDIR,                  /* Change the current directory. */
@@ -0,0 +1,442 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syscall.h>
+
+/* The user-space malloc().
+
+   The heap is a run of "chunks" between the start of the heap
+   and the break, each with a header giving its own size and the
+   size of the chunk before it.  The last chunk, the "top", is
+   always free and is where new chunks are carved from; when it
+   runs short, sbrk() grows it by at least GROW_SIZE bytes, and
+   when it grows past TRIM_SIZE it is given back down to
+   GROW_SIZE.
+
+   Chunks of up to SMALL_MAX bytes are freed onto a singly linked
+   list for their exact size, without being merged with their
+   neighbours, so that the common case of allocating and freeing
+   small objects takes a few instructions.  Before the heap is
+   grown, though, all of those chunks are freed for real, so that
+   they do not keep the free space around them in pieces forever.
+   Other free chunks,
+   including the pieces left over when a chunk is split, are
+   merged with any free neighbours, using the size fields in the
+   headers to find them, and kept on doubly linked "large bins",
+   one for each power of 2 of sizes, searched first-fit.
+
+   realloc() grows a block in place when the chunk after it is
+   free or is the top.
+
+   malloc() assumes that nothing else in the program moves the
+   break with sbrk(). */
+
+/* A chunk. */
+struct chunk
+  {
+    size_t prev_size;           /* Size of previous chunk, 0 if none. */
+    size_t size;                /* Size of this chunk, plus CHUNK_USED. */
+
+    /* Free chunks only; where the user data starts otherwise. */
+    struct chunk *next;         /* Next chunk in free list. */
+    struct chunk *prev;         /* Previous chunk in free list. */
+  };
+
+/* In SIZE, set if the chunk is allocated or on a small list. */
+#define CHUNK_USED 1
+
+#define ALIGN 8                          /* Alignment of blocks. */
+#define HDR_SIZE 8                       /* Bytes of header in a chunk. */
+#define MIN_CHUNK 16                     /* Smallest chunk. */
+#define SMALL_MAX 512                    /* Largest small chunk. */
+#define GROW_SIZE (64 * 1024)            /* Minimum heap growth. */
+#define TRIM_SIZE (256 * 1024)           /* Top size that is trimmed. */
+#define LARGE_BIN_CNT 32                 /* One per power of 2. */
+
+static struct chunk *top;                        /* Last chunk. */
+static struct chunk *small_bins[SMALL_MAX / ALIGN + 1]; /* By size / 8. */
+static struct chunk large_bins[LARGE_BIN_CNT];   /* By log2(size). */
+
+static bool heap_init (void);
+static bool grow_top (size_t size);
+static struct chunk *take_from_top (size_t size);
+static void split (struct chunk *, size_t size);
+static void make_free (struct chunk *);
+static bool consolidate (void);
+
+/* Returns the size of chunk C. */
+static inline size_t
+chunk_size (const struct chunk *c)
+{
+  return c->size & ~(size_t) CHUNK_USED;
+}
+
+/* Returns the chunk after C. */
+static inline struct chunk *
+next_chunk (struct chunk *c)
+{
+  return (struct chunk *) ((uint8_t *) c + chunk_size (c));
+}
+
+/* Returns the chunk containing user block P. */
+static inline struct chunk *
+block_to_chunk (void *p)
+{
+  return (struct chunk *) ((uint8_t *) p - HDR_SIZE);
+}
+
+/* Returns the user block in chunk C. */
+static inline void *
+chunk_to_block (struct chunk *c)
+{
+  return (uint8_t *) c + HDR_SIZE;
+}
+
+/* Returns the size of chunk needed for a block of N bytes, or 0
+   if N is too large. */
+static size_t
+request_to_size (size_t n)
+{
+  size_t size;
+
+  if (n > SIZE_MAX - HDR_SIZE - ALIGN)
+    return 0;
+  size = (n + HDR_SIZE + ALIGN - 1) & ~(size_t) (ALIGN - 1);
+  return size < MIN_CHUNK ? MIN_CHUNK : size;
+}
+
+/* Returns the large bin for chunks of SIZE bytes. */
+static struct chunk *
+large_bin (size_t size)
+{
+  return &large_bins[31 - __builtin_clz (size)];
+}
+
+/* Adds free chunk C to its large bin. */
+static void
+bin_insert (struct chunk *c)
+{
+  struct chunk *bin = large_bin (chunk_size (c));
+
+  c->next = bin->next;
+  c->prev = bin;
+  bin->next->prev = c;
+  bin->next = c;
+}
+
+/* Removes free chunk C from its large bin. */
+static void
+bin_remove (struct chunk *c)
+{
+  c->prev->next = c->next;
+  c->next->prev = c->prev;
+}
+
+/* Obtains and returns a new block of at least N bytes.
+   Returns a null pointer if N is 0 or memory is not available. */
+void *
+malloc (size_t n)
+{
+  size_t size = request_to_size (n);
+  struct chunk *bin, *c;
+
+  if (n == 0 || size == 0)
+    return NULL;
+  if (top == NULL && !heap_init ())
+    return NULL;
+
+  /* Try the small list for exactly this size. */
+  if (size <= SMALL_MAX && small_bins[size / ALIGN] != NULL)
+    {
+      c = small_bins[size / ALIGN];
+      small_bins[size / ALIGN] = c->next;
+      return chunk_to_block (c);
+    }
+
+  /* Try the large bins, starting from the one for SIZE.  Any
+     chunk in a later bin is big enough. */
+  do
+    {
+      for (bin = large_bin (size); bin < large_bins + LARGE_BIN_CNT; bin++)
+        for (c = bin->next; c != bin; c = c->next)
+          if (chunk_size (c) >= size)
+            {
+              bin_remove (c);
+              split (c, size);
+              return chunk_to_block (c);
+            }
+    }
+  while (chunk_size (top) < size + MIN_CHUNK && consolidate ());
+
+  /* Carve a new chunk from the top. */
+  c = take_from_top (size);
+  return c != NULL ? chunk_to_block (c) : NULL;
+}
+
+/* Allocates and return A times B bytes initialized to zeroes.
+   Returns a null pointer if memory is not available. */
+void *
+calloc (size_t a, size_t b)
+{
+  void *p;
+  size_t size;
+
+  /* Calculate block size and make sure it fits in size_t. */
+  size = a * b;
+  if (a != 0 && size / a != b)
+    return NULL;
+
+  /* Allocate and zero memory. */
+  p = malloc (size);
+  if (p != NULL)
+    memset (p, 0, size);
+  return p;
+}
+
+/* Attempts to resize OLD_BLOCK to N bytes, possibly moving it in
+   the process.
+   If successful, returns the new block; on failure, returns a
+   null pointer, leaving OLD_BLOCK alone.
+   A call with null OLD_BLOCK is equivalent to malloc(N).
+   A call with zero N is equivalent to free(OLD_BLOCK). */
+void *
+realloc (void *old_block, size_t n)
+{
+  struct chunk *c, *next;
+  size_t old_size, size;
+  void *new_block;
+
+  if (old_block == NULL)
+    return malloc (n);
+  if (n == 0)
+    {
+      free (old_block);
+      return NULL;
+    }
+
+  size = request_to_size (n);
+  if (size == 0)
+    return NULL;
+  c = block_to_chunk (old_block);
+  old_size = chunk_size (c);
+
+  /* Shrink in place. */
+  if (size <= old_size)
+    {
+      if (old_size > SMALL_MAX)
+        split (c, size);
+      return old_block;
+    }
+
+  /* Grow in place into the top or a free chunk after this one. */
+  next = next_chunk (c);
+  if (next == top)
+    {
+      if (grow_top (size - old_size))
+        {
+          size_t top_size = chunk_size (top) - (size - old_size);
+          top = (struct chunk *) ((uint8_t *) c + size);
+          top->prev_size = size;
+          top->size = top_size;
+          c->size = size | CHUNK_USED;
+          return old_block;
+        }
+    }
+  else if (!(next->size & CHUNK_USED)
+           && old_size + chunk_size (next) >= size)
+    {
+      bin_remove (next);
+      c->size = (old_size + chunk_size (next)) | CHUNK_USED;
+      next_chunk (c)->prev_size = chunk_size (c);
+      split (c, size);
+      return old_block;
+    }
+
+  /* Move it. */
+  new_block = malloc (n);
+  if (new_block != NULL)
+    {
+      memcpy (new_block, old_block, old_size - HDR_SIZE);
+      free (old_block);
+    }
+  return new_block;
+}
+
+/* Frees block P, which must have been previously allocated with
+   malloc(), calloc(), or realloc(). */
+void
+free (void *p)
+{
+  struct chunk *c;
+  size_t size;
+
+  if (p == NULL)
+    return;
+
+  c = block_to_chunk (p);
+  size = chunk_size (c);
+  if (size <= SMALL_MAX)
+    {
+      /* Leave it marked as used, so that it is not merged. */
+      c->next = small_bins[size / ALIGN];
+      small_bins[size / ALIGN] = c;
+    }
+  else
+    {
+      c->size = size;
+      make_free (c);
+    }
+}
+
+/* Frees every chunk on the small lists, merging each with its
+   free neighbours.  Returns true if there were any. */
+static bool
+consolidate (void)
+{
+  bool any = false;
+  size_t i;
+
+  for (i = 0; i < sizeof small_bins / sizeof *small_bins; i++)
+    while (small_bins[i] != NULL)
+      {
+        struct chunk *c = small_bins[i];
+
+        small_bins[i] = c->next;
+        c->size = chunk_size (c);
+        make_free (c);
+        any = true;
+      }
+  return any;
+}
+
+/* Sets up the heap, with an empty top chunk at the break.
+   Returns true if successful. */
+static bool
+heap_init (void)
+{
+  uint8_t *base = sbrk (0);
+  size_t pad;
+  int i;
+
+  if (base == SBRK_FAILED)
+    return false;
+  pad = -(uintptr_t) base & (ALIGN - 1);
+  if (sbrk (pad + GROW_SIZE) != base)
+    return false;
+
+  for (i = 0; i < LARGE_BIN_CNT; i++)
+    large_bins[i].next = large_bins[i].prev = &large_bins[i];
+
+  top = (struct chunk *) (base + pad);
+  top->prev_size = 0;
+  top->size = GROW_SIZE;
+  return true;
+}
+
+/* Makes sure that SIZE bytes can be taken from the top, leaving
+   it at least MIN_CHUNK bytes.  Returns true if successful. */
+static bool
+grow_top (size_t size)
+{
+  size_t top_size = chunk_size (top);
+  uint8_t *top_end = (uint8_t *) top + top_size;
+  size_t increment;
+
+  if (top_size >= size + MIN_CHUNK)
+    return true;
+
+  increment = size + MIN_CHUNK - top_size;
+  if (increment < GROW_SIZE)
+    increment = GROW_SIZE;
+  if ((intptr_t) increment < 0 || sbrk (increment) != top_end)
+    return false;
+  top->size = top_size + increment;
+  return true;
+}
+
+/* Takes a chunk of SIZE bytes from the start of the top, and
+   returns it.  Returns a null pointer if the heap cannot grow. */
+static struct chunk *
+take_from_top (size_t size)
+{
+  struct chunk *c = top;
+  size_t top_size;
+
+  if (!grow_top (size))
+    return NULL;
+
+  top_size = chunk_size (c) - size;
+  top = (struct chunk *) ((uint8_t *) c + size);
+  top->prev_size = size;
+  top->size = top_size;
+  c->size = size | CHUNK_USED;
+  return c;
+}
+
+/* Marks chunk C as used and, if it is bigger than SIZE by enough
+   to hold another chunk, cuts it down to SIZE and frees the
+   rest. */
+static void
+split (struct chunk *c, size_t size)
+{
+  size_t c_size = chunk_size (c);
+
+  if (c_size - size >= MIN_CHUNK)
+    {
+      struct chunk *rest = (struct chunk *) ((uint8_t *) c + size);
+
+      c->size = size | CHUNK_USED;
+      rest->prev_size = size;
+      rest->size = c_size - size;
+      next_chunk (rest)->prev_size = c_size - size;
+      make_free (rest);
+    }
+  else
+    c->size = c_size | CHUNK_USED;
+}
+
+/* Merges free chunk C, which is in no bin, with its free
+   neighbours, and puts the result in a large bin or makes it part
+   of the top.  Gives memory back to the system if the top has
+   grown large. */
+static void
+make_free (struct chunk *c)
+{
+  size_t size = chunk_size (c);
+  struct chunk *next;
+
+  if (c->prev_size != 0)
+    {
+      struct chunk *prev = (struct chunk *) ((uint8_t *) c - c->prev_size);
+      if (!(prev->size & CHUNK_USED))
+        {
+          bin_remove (prev);
+          size += chunk_size (prev);
+          c = prev;
+        }
+    }
+
+  next = (struct chunk *) ((uint8_t *) c + size);
+  if (next == top)
+    {
+      top = c;
+      top->size = size + chunk_size (next);
+      if (top->size > TRIM_SIZE)
+        {
+          size_t excess = (top->size - GROW_SIZE) & ~(size_t) 4095;
+          if (sbrk (-(intptr_t) excess) != SBRK_FAILED)
+            top->size -= excess;
+        }
+      return;
+    }
+
+  if (!(next->size & CHUNK_USED))
+    {
+      bin_remove (next);
+      size += chunk_size (next);
+    }
+  c->size = size;
+  next_chunk (c)->prev_size = size;
+  bin_insert (c);
+}
@@ -2,6 +2,8 @@
 #define __LIB_USER_SYSCALL_H
 
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
 #include <debug.h>
 
 /* Process identifier. */
@@ -12,6 +14,21 @@ typedef int pid_t;
 typedef int mapid_t;
 #define MAP_FAILED ((mapid_t) -1)
 
+/* Return value of sbrk() on failure. */
+#define SBRK_FAILED ((void *) -1)
+
+/* A process's memory usage, as reported by memstat(). */
+struct memstat
+  {
+    size_t resident_pages;      /* Pages in memory. */
+    size_t shared_pages;        /* Of those, shared with other pages. */
+    size_t swapped_pages;       /* Pages only in swap. */
+    size_t peak_resident_pages; /* Most pages ever in memory at once. */
+    size_t working_set_pages;   /* Pages used recently; see -ww. */
+    long long minor_faults;     /* Page faults resolved without I/O. */
+    long long major_faults;     /* Page faults that read a page in. */
+  };
+
 /* Maximum characters in a filename written by readdir(). */
 #define READDIR_MAX_LEN 14
 
@@ -42,6 +59,9 @@ int sum_of_four_integers(int a, int b, int c, int d);
 /* Project 3 and optionally project 4. */
 mapid_t mmap (int fd, void *addr);
 void munmap (mapid_t);
+pid_t fork (void);
+void *sbrk (intptr_t increment);
+bool memstat (struct memstat *);
 
 /* Project 4 only. */
 bool chdir (const char *dir);
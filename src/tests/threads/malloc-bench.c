@@ -0,0 +1,213 @@
+/* Measures the speed of malloc() and free() and how well the
+   pages held by malloc() are used, against the way malloc() used
+   to work.
+
+   First keeps BLOCK_CNT blocks of random sizes live, replacing
+   a random one at a time, and reports operations per second.
+   Then reports how many bytes were requested for the live
+   blocks against the pages malloc() needed to hold them, and
+   how much of their blocks would have been wasted with a size
+   class per power of 2 only, against the classes in use now.
+
+   Next compares finding the size class for a request with a
+   linear scan of the classes, as malloc() used to, against
+   malloc_block_size(), which computes it from the size, and
+   checks that the two agree for every size.
+
+   Finally allocates and frees a single block over and over,
+   first with no spare arenas, which makes malloc() pass a page
+   back and forth with the page allocator every time, as it used
+   to, and then with the default spare arena.  Both runs report
+   how many arenas malloc() obtained. */
+
+#include <random.h>
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/malloc.h"
+#include "threads/vaddr.h"
+#include "devices/timer.h"
+
+#define BLOCK_CNT 1000          /* Live blocks. */
+#define ROUNDS 100              /* Replacements per live block. */
+#define MAX_SIZE 1024           /* Largest block, in bytes. */
+#define PINGPONG_CNT 100000     /* Single-block malloc/free pairs. */
+#define LOOKUP_CNT 1000000      /* Size class lookups. */
+
+static void *blocks[BLOCK_CNT];
+static size_t sizes[BLOCK_CNT];
+
+/* Block sizes of the size classes, smallest first. */
+static size_t classes[32];
+static size_t class_cnt;
+static size_t max_class_size;   /* Largest, the last of them. */
+
+/* Reports OPS operations done since START, named WHAT. */
+static void
+report_rate (const char *what, long long ops, int64_t start)
+{
+  int64_t ticks = timer_elapsed (start);
+
+  if (ticks < 1)
+    ticks = 1;
+  msg ("%s: %lld ops in %lld ticks, %lld ops/s",
+       what, ops, ticks, ops * TIMER_FREQ / ticks);
+}
+
+/* Returns the block size that a SIZE-byte request got with one
+   size class per power of 2, from 16 bytes up. */
+static size_t
+power_of_2_size (size_t size)
+{
+  size_t block_size = 16;
+
+  while (block_size < size)
+    block_size *= 2;
+  return block_size;
+}
+
+/* Returns the block size for a SIZE-byte request found the way
+   malloc() used to, by scanning the classes in order. */
+static size_t
+linear_lookup (size_t size)
+{
+  size_t i;
+
+  for (i = 0; i < class_cnt; i++)
+    if (classes[i] >= size)
+      return classes[i];
+  return 0;
+}
+
+/* Collects the size classes and checks that every request small
+   enough for one gets a block that fits it with at most a third
+   of it wasted, and that the linear scan finds the same class as
+   malloc_block_size(). */
+static void
+check_classes (void)
+{
+  size_t size, block_size;
+
+  class_cnt = 0;
+  for (size = 1; (block_size = malloc_block_size (size)) != 0; size++)
+    {
+      if (block_size < size)
+        fail ("%zu-byte request gets a %zu-byte block", size, block_size);
+      if (block_size > 16 && (block_size - size) * 3 >= block_size)
+        fail ("%zu-byte request wastes too much of a %zu-byte block",
+              size, block_size);
+      if (class_cnt == 0 || classes[class_cnt - 1] != block_size)
+        {
+          ASSERT (class_cnt < sizeof classes / sizeof *classes);
+          classes[class_cnt++] = block_size;
+        }
+    }
+  if (class_cnt == 0)
+    fail ("no size classes");
+  max_class_size = classes[class_cnt - 1];
+  for (size = 1; size <= max_class_size; size++)
+    if (linear_lookup (size) != malloc_block_size (size))
+      fail ("linear scan and malloc disagree on a %zu-byte request",
+            size);
+  msg ("%zu size classes agree", class_cnt);
+}
+
+/* Allocates and frees a single block PINGPONG_CNT times with
+   RESERVE spare arenas per size class, and reports the rate and
+   the arenas obtained as WHAT.  Returns the arenas obtained. */
+static size_t
+pingpong (const char *what, size_t reserve)
+{
+  size_t old_reserve = malloc_arena_reserve;
+  size_t new_cnt;
+  int64_t start;
+  char name[64];
+  int i;
+
+  malloc_arena_reserve = reserve;
+  new_cnt = malloc_arena_new_cnt ();
+  start = timer_ticks ();
+  for (i = 0; i < PINGPONG_CNT; i++)
+    {
+      void *p = malloc (MAX_SIZE);
+      if (p == NULL)
+        fail ("malloc of %d bytes failed", MAX_SIZE);
+      free (p);
+    }
+  snprintf (name, sizeof name, "single block, %s", what);
+  report_rate (name, 2LL * PINGPONG_CNT, start);
+  new_cnt = malloc_arena_new_cnt () - new_cnt;
+  msg ("single block, %s: %zu arenas obtained", what, new_cnt);
+  malloc_arena_reserve = old_reserve;
+  return new_cnt;
+}
+
+void
+test_malloc_bench (void)
+{
+  size_t arenas_before, arenas, requested, old_blocks, new_blocks;
+  size_t no_spare, spare;
+  volatile size_t sink = 0;
+  int64_t start;
+  int i;
+
+  random_init (0);
+  check_classes ();
+  arenas_before = malloc_arena_cnt ();
+
+  /* Replace random blocks with blocks of random sizes. */
+  start = timer_ticks ();
+  for (i = 0; i < BLOCK_CNT * ROUNDS; i++)
+    {
+      int j = random_ulong () % BLOCK_CNT;
+
+      free (blocks[j]);
+      sizes[j] = random_ulong () % MAX_SIZE + 1;
+      blocks[j] = malloc (sizes[j]);
+      if (blocks[j] == NULL)
+        fail ("malloc of %zu bytes failed", sizes[j]);
+    }
+  report_rate ("random sizes", 2LL * BLOCK_CNT * ROUNDS, start);
+
+  /* Compare the bytes in use with the pages and blocks holding
+     them. */
+  requested = old_blocks = new_blocks = 0;
+  for (i = 0; i < BLOCK_CNT; i++)
+    if (blocks[i] != NULL)
+      {
+        requested += sizes[i];
+        old_blocks += power_of_2_size (sizes[i]);
+        new_blocks += malloc_block_size (sizes[i]);
+      }
+  arenas = malloc_arena_cnt () - arenas_before;
+  msg ("%zu bytes live in %zu pages, %zu%% used",
+       requested, arenas, requested * 100 / (arenas * PGSIZE));
+  msg ("block bytes wasted: %zu%% with powers of 2, %zu%% now",
+       (old_blocks - requested) * 100 / old_blocks,
+       (new_blocks - requested) * 100 / new_blocks);
+
+  for (i = 0; i < BLOCK_CNT; i++)
+    {
+      free (blocks[i]);
+      blocks[i] = NULL;
+    }
+
+  /* Find size classes both ways. */
+  start = timer_ticks ();
+  for (i = 0; i < LOOKUP_CNT; i++)
+    sink += linear_lookup (i % max_class_size + 1);
+  report_rate ("class lookup, linear scan", LOOKUP_CNT, start);
+  start = timer_ticks ();
+  for (i = 0; i < LOOKUP_CNT; i++)
+    sink += malloc_block_size (i % max_class_size + 1);
+  report_rate ("class lookup, computed", LOOKUP_CNT, start);
+
+  /* Allocate and free a single block over and over. */
+  no_spare = pingpong ("no spare arena", 0);
+  spare = pingpong ("spare arena", malloc_arena_reserve);
+  if (no_spare < PINGPONG_CNT / 2)
+    fail ("only %zu arenas obtained without a spare arena", no_spare);
+  if (spare > 1)
+    fail ("%zu arenas obtained with a spare arena", spare);
+
+  pass ();
+}
@@ -0,0 +1,39 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+
+our ($test);
+my (@output) = read_text_file ("$test.output");
+
+common_checks ("run", @output);
+
+@output = get_core_output ("run", @output);
+fail "missing PASS in output"
+  unless grep ($_ eq '(malloc-bench) PASS', @output);
+
+# Finer size classes must waste less of each block than one
+# class per power of 2.
+my ($waste) = grep (/block bytes wasted/, @output);
+fail "missing block waste report"
+  unless defined ($waste)
+    && $waste =~ /: (\d+)% with powers of 2, (\d+)% now$/;
+my ($old_waste, $new_waste) = ($1, $2);
+fail "blocks waste $new_waste% now, against $old_waste% before"
+  unless $new_waste < $old_waste;
+
+# Without a spare arena, every malloc/free pair of a lone block
+# passes a page through the page allocator; with one, it does not.
+my (%arenas);
+foreach (@output) {
+    $arenas{$1} = $2 if /single block, (.*): (\d+) arenas obtained$/;
+}
+fail "missing arena counts"
+  unless defined ($arenas{'no spare arena'})
+    && defined ($arenas{'spare arena'});
+fail "only $arenas{'no spare arena'} arenas obtained without a spare arena"
+  unless $arenas{'no spare arena'} > 1000;
+fail "$arenas{'spare arena'} arenas obtained with a spare arena"
+  unless $arenas{'spare arena'} <= 1;
+
+pass;
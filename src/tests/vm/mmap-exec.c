@@ -0,0 +1,35 @@
+/* Tries to map the running executable, which must fail: a
+   mapping is writable, and writes to a running executable are
+   denied.  Then runs the executable again in a child process,
+   which must still work. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+
+#define ACTUAL ((void *) 0x10000000)
+
+int
+main (int argc, char *argv[] UNUSED) 
+{
+  int handle;
+  pid_t child;
+
+  test_name = "mmap-exec";
+  if (argc > 1)
+    {
+      msg ("child run");
+      return 81;
+    }
+
+  msg ("begin");
+  CHECK ((handle = open ("mmap-exec")) > 1, "open \"mmap-exec\"");
+  CHECK (mmap (handle, ACTUAL) == MAP_FAILED,
+         "try to mmap \"mmap-exec\" (must fail)");
+  close (handle);
+
+  CHECK ((child = exec ("mmap-exec child")) != -1,
+         "exec \"mmap-exec child\"");
+  CHECK (wait (child) == 81, "wait for child");
+  msg ("end");
+  return 0;
+}
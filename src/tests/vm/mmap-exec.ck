@@ -0,0 +1,14 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(mmap-exec) begin
+(mmap-exec) open "mmap-exec"
+(mmap-exec) try to mmap "mmap-exec" (must fail)
+(mmap-exec) exec "mmap-exec child"
+(mmap-exec) child run
+(mmap-exec) wait for child
+(mmap-exec) end
+EOF
+pass;
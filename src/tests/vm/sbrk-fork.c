@@ -0,0 +1,53 @@
+/* Fills a malloc'd block, forks, and verifies that the child
+   sees the same heap, and that its writes to the heap do not
+   reach the parent's. */
+
+#include <stdlib.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define BLOCK_SIZE (16 * 1024)
+
+/* Checks that BLOCK holds the pattern written by test_main(). */
+static void
+check_block (const char *block, const char *who)
+{
+  size_t i;
+
+  for (i = 0; i < BLOCK_SIZE; i++)
+    if (block[i] != (char) (i % 253))
+      fail ("%s: byte %zu of heap block is wrong", who, i);
+  msg ("%s: heap contents intact", who);
+}
+
+void
+test_main (void)
+{
+  char *block, *brk;
+  size_t i;
+  pid_t pid;
+
+  CHECK ((block = malloc (BLOCK_SIZE)) != NULL, "malloc 16 kB");
+  for (i = 0; i < BLOCK_SIZE; i++)
+    block[i] = i % 253;
+  brk = sbrk (0);
+
+  msg ("fork");
+  pid = fork ();
+  if (pid == 0)
+    {
+      if (sbrk (0) != brk)
+        fail ("child: break differs from parent's");
+      check_block (block, "child");
+      memset (block, 0, BLOCK_SIZE);
+      free (block);
+      CHECK ((block = malloc (2 * BLOCK_SIZE)) != NULL,
+             "child: malloc 32 kB");
+      exit (81);
+    }
+  CHECK (pid != PID_ERROR && wait (pid) == 81, "wait for child");
+  check_block (block, "parent");
+  free (block);
+}
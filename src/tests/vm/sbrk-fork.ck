@@ -0,0 +1,15 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(sbrk-fork) begin
+(sbrk-fork) malloc 16 kB
+(sbrk-fork) fork
+(sbrk-fork) child: heap contents intact
+(sbrk-fork) child: malloc 32 kB
+(sbrk-fork) wait for child
+(sbrk-fork) parent: heap contents intact
+(sbrk-fork) end
+EOF
+pass;
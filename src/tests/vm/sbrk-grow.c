@@ -0,0 +1,42 @@
+/* Grows the heap with sbrk(), checks that the new memory reads
+   as zeros and keeps what is written to it, and shrinks the heap
+   back.  Then does the same through malloc(). */
+
+#include <stdlib.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define SIZE (3 * 4096 + 123)
+#define BLOCK_SIZE (64 * 1024)
+
+void
+test_main (void)
+{
+  char *base, *block;
+  size_t i;
+
+  base = sbrk (0);
+  CHECK (sbrk (SIZE) == base, "grow heap by %d bytes", SIZE);
+  CHECK (sbrk (0) == base + SIZE, "check new break");
+  for (i = 0; i < SIZE; i++)
+    if (base[i] != 0)
+      fail ("byte %zu of new heap memory is nonzero", i);
+  for (i = 0; i < SIZE; i++)
+    base[i] = i % 251;
+  for (i = 0; i < SIZE; i++)
+    if (base[i] != (char) (i % 251))
+      fail ("byte %zu of heap memory reads back wrong", i);
+  msg ("heap memory reads back");
+  CHECK (sbrk (-SIZE) == base + SIZE, "shrink heap back");
+  CHECK (sbrk (0) == base, "check old break");
+
+  CHECK ((block = malloc (BLOCK_SIZE)) != NULL, "malloc 64 kB");
+  memset (block, 0x5a, BLOCK_SIZE);
+  for (i = 0; i < BLOCK_SIZE; i++)
+    if (block[i] != 0x5a)
+      fail ("byte %zu of malloc'd block reads back wrong", i);
+  msg ("malloc'd block reads back");
+  free (block);
+}
@@ -0,0 +1,17 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(sbrk-grow) begin
+(sbrk-grow) grow heap by 12411 bytes
+(sbrk-grow) check new break
+(sbrk-grow) heap memory reads back
+(sbrk-grow) shrink heap back
+(sbrk-grow) check old break
+(sbrk-grow) malloc 64 kB
+(sbrk-grow) malloc'd block reads back
+(sbrk-grow) end
+sbrk-grow: exit(0)
+EOF
+pass;
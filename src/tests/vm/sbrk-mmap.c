@@ -0,0 +1,38 @@
+/* Maps a file a few pages above the break and verifies that the
+   heap can grow up to the mapping but not into it, that the file
+   cannot be mapped over the heap either, and that the heap can
+   grow where the mapping was once it is removed. */
+
+#include <round.h>
+#include <stdint.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/vm/sample.inc"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void)
+{
+  char *base = sbrk (0);
+  char *map_addr = (char *) ROUND_UP ((uintptr_t) base, 4096) + 4 * 4096;
+  int handle;
+  mapid_t map;
+
+  CHECK ((handle = open ("sample.txt")) > 1, "open \"sample.txt\"");
+  CHECK ((map = mmap (handle, map_addr)) != MAP_FAILED,
+         "mmap \"sample.txt\" above the break");
+  CHECK (sbrk (map_addr - base + 1) == SBRK_FAILED,
+         "try to grow heap into the mapping");
+  CHECK (sbrk (0) == base, "check break is unchanged");
+  CHECK (!memcmp (map_addr, sample, strlen (sample)),
+         "check mapping is unchanged");
+  CHECK (sbrk (map_addr - base) == base, "grow heap up to the mapping");
+  CHECK (mmap (handle, base) == MAP_FAILED,
+         "try to mmap \"sample.txt\" over the heap");
+
+  munmap (map);
+  CHECK (sbrk (4096) == map_addr, "grow heap where the mapping was");
+  if (map_addr[0] != 0)
+    fail ("new heap page is not zeroed");
+}
@@ -0,0 +1,18 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(sbrk-mmap) begin
+(sbrk-mmap) open "sample.txt"
+(sbrk-mmap) mmap "sample.txt" above the break
+(sbrk-mmap) try to grow heap into the mapping
+(sbrk-mmap) check break is unchanged
+(sbrk-mmap) check mapping is unchanged
+(sbrk-mmap) grow heap up to the mapping
+(sbrk-mmap) try to mmap "sample.txt" over the heap
+(sbrk-mmap) grow heap where the mapping was
+(sbrk-mmap) end
+sbrk-mmap: exit(0)
+EOF
+pass;
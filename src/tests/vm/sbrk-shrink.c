@@ -0,0 +1,18 @@
+/* Verifies that the heap cannot be shrunk below its start, and
+   that a failed sbrk() leaves the break where it was. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void)
+{
+  char *base = sbrk (0);
+
+  CHECK (sbrk (-1) == SBRK_FAILED, "try to shrink empty heap");
+  CHECK (sbrk (4096) == base, "grow heap by a page");
+  CHECK (sbrk (-8192) == SBRK_FAILED, "try to shrink heap below its start");
+  CHECK (sbrk (0) == base + 4096, "check break is unchanged");
+  CHECK (sbrk (-4096) == base + 4096, "shrink heap to its start");
+}
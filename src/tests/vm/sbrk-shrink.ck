@@ -0,0 +1,15 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(sbrk-shrink) begin
+(sbrk-shrink) try to shrink empty heap
+(sbrk-shrink) grow heap by a page
+(sbrk-shrink) try to shrink heap below its start
+(sbrk-shrink) check break is unchanged
+(sbrk-shrink) shrink heap to its start
+(sbrk-shrink) end
+sbrk-shrink: exit(0)
+EOF
+pass;
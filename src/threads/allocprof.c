@@ -0,0 +1,248 @@
+#include "threads/allocprof.h"
+#include <debug.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "threads/interrupt.h"
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/vaddr.h"
+
+/* Kernel allocation profiler.
+
+   When enabled with the "-ap" option, malloc(), calloc(),
+   realloc(), slab_alloc() and palloc_get_multiple() report each
+   block they hand out, along with the return address of their
+   caller, and free(), slab_free() and palloc_free_multiple()
+   report each block they take back.  malloc() and slab_alloc()
+   get their own pages with PAL_NOPROF, so that their blocks are
+   charged only to the code that asked for them.  Every call site
+   is charged with the bytes it has live, the most it ever had
+   live, and its allocations and frees.  At shutdown the call
+   sites are printed in order of live bytes, then peak bytes.
+
+   The live blocks are kept in an open-addressed hash table, and
+   the call sites in another, both allocated from the page
+   allocator at startup and of fixed size, so that profiling
+   never calls the allocators it profiles.  Blocks allocated
+   before allocprof_init(), or while a table is full, are not
+   tracked, and their frees are ignored.
+
+   The tables are protected by turning interrupts off, because
+   pages are freed from within the scheduler.
+
+   When the profiler is disabled, the allocators only test
+   allocprof_enabled. */
+
+bool allocprof_enabled;
+
+/* A live block. */
+struct block_rec
+  {
+    void *block;                /* The block, or null if unused. */
+    size_t size;                /* Size in bytes. */
+    struct site_rec *site;      /* Where it was allocated. */
+  };
+
+/* A call site. */
+struct site_rec
+  {
+    void *site;                 /* Return address, or null if unused. */
+    size_t live_bytes;          /* Bytes currently allocated. */
+    size_t peak_bytes;          /* Maximum of LIVE_BYTES. */
+    long long alloc_cnt;        /* Number of allocations. */
+    long long free_cnt;         /* Number of frees. */
+  };
+
+/* Table sizes, in pages.  Must yield powers of 2 entries. */
+#define BLOCK_PAGES 32
+#define SITE_PAGES 4
+#define BLOCK_CNT (BLOCK_PAGES * PGSIZE / 16)
+#define SITE_CNT (SITE_PAGES * PGSIZE / 32)
+
+static struct block_rec *blocks;        /* BLOCK_CNT entries. */
+static struct site_rec *sites;          /* SITE_CNT entries. */
+static size_t block_cnt;                /* Live blocks tracked. */
+static long long untracked_cnt;         /* Allocations not tracked. */
+
+static size_t hash_ptr (const void *, size_t cnt);
+
+/* Allocates the profiler's tables, if profiling is enabled.
+   Must be called after palloc_init(). */
+void
+allocprof_init (void)
+{
+  if (!allocprof_enabled)
+    return;
+
+  ASSERT (sizeof (struct block_rec) <= 16);
+  ASSERT (sizeof (struct site_rec) <= 32);
+
+  /* Allocate with profiling off, so as not to track ourselves. */
+  allocprof_enabled = false;
+  blocks = palloc_get_multiple (PAL_ASSERT | PAL_ZERO, BLOCK_PAGES);
+  sites = palloc_get_multiple (PAL_ASSERT | PAL_ZERO, SITE_PAGES);
+  allocprof_enabled = true;
+}
+
+/* Records that BLOCK, SIZE bytes long, was allocated by the call
+   at return address SITE.  Returns true if BLOCK is now tracked,
+   false if a table is full or the profiler is not ready. */
+bool
+allocprof_alloc (void *block, size_t size, void *site)
+{
+  enum intr_level old_level;
+  struct site_rec *s = NULL;
+  struct block_rec *b = NULL;
+  size_t i, n;
+
+  if (blocks == NULL || block == NULL)
+    return false;
+
+  old_level = intr_disable ();
+
+  /* Find or add the call site. */
+  for (i = hash_ptr (site, SITE_CNT), n = 0; n < SITE_CNT;
+       i = (i + 1) % SITE_CNT, n++)
+    if (sites[i].site == site || sites[i].site == NULL)
+      {
+        s = &sites[i];
+        s->site = site;
+        break;
+      }
+
+  /* Add the block, if there is room for it. */
+  if (s != NULL && block_cnt < BLOCK_CNT * 3 / 4)
+    for (i = hash_ptr (block, BLOCK_CNT); ; i = (i + 1) % BLOCK_CNT)
+      if (blocks[i].block == NULL)
+        {
+          b = &blocks[i];
+          b->block = block;
+          b->size = size;
+          b->site = s;
+          block_cnt++;
+          break;
+        }
+
+  if (b != NULL)
+    {
+      s->alloc_cnt++;
+      s->live_bytes += size;
+      if (s->live_bytes > s->peak_bytes)
+        s->peak_bytes = s->live_bytes;
+    }
+  else
+    untracked_cnt++;
+
+  intr_set_level (old_level);
+  return b != NULL;
+}
+
+/* Records that BLOCK was freed.  Returns the size it was
+   allocated with, or 0 if it was not tracked. */
+size_t
+allocprof_free (void *block)
+{
+  enum intr_level old_level;
+  size_t size = 0;
+  size_t i, j;
+
+  if (blocks == NULL || block == NULL)
+    return 0;
+
+  old_level = intr_disable ();
+
+  for (i = hash_ptr (block, BLOCK_CNT); blocks[i].block != NULL;
+       i = (i + 1) % BLOCK_CNT)
+    if (blocks[i].block == block)
+      break;
+
+  if (blocks[i].block != NULL)
+    {
+      struct site_rec *s = blocks[i].site;
+
+      size = blocks[i].size;
+      s->live_bytes -= size;
+      s->free_cnt++;
+      block_cnt--;
+
+      /* Delete entry I, moving later entries of its run back
+         into the hole so that lookups still find them. */
+      blocks[i].block = NULL;
+      for (j = (i + 1) % BLOCK_CNT; blocks[j].block != NULL;
+           j = (j + 1) % BLOCK_CNT)
+        {
+          size_t home = hash_ptr (blocks[j].block, BLOCK_CNT);
+          if ((j > i && (home <= i || home > j))
+              || (j < i && home <= i && home > j))
+            {
+              blocks[i] = blocks[j];
+              blocks[j].block = NULL;
+              i = j;
+            }
+        }
+    }
+
+  intr_set_level (old_level);
+  return size;
+}
+
+/* Returns true if call site A should be reported before B. */
+static bool
+site_before (const struct site_rec *a, const struct site_rec *b)
+{
+  if (a->live_bytes != b->live_bytes)
+    return a->live_bytes > b->live_bytes;
+  return a->peak_bytes > b->peak_bytes;
+}
+
+/* Prints the call sites, sorted, if profiling is enabled. */
+void
+allocprof_print_stats (void)
+{
+  size_t site_cnt = 0;
+  size_t i, j;
+
+  if (sites == NULL)
+    return;
+
+  /* Gather the used entries at the front and sort them.  This
+     runs only at shutdown, so a simple insertion sort will do. */
+  for (i = 0; i < SITE_CNT; i++)
+    if (sites[i].site != NULL)
+      {
+        struct site_rec s = sites[i];
+
+        for (j = site_cnt; j > 0 && site_before (&s, &sites[j - 1]); j--)
+          sites[j] = sites[j - 1];
+        sites[j] = s;
+        site_cnt++;
+      }
+
+  printf ("Allocation profile: %zu call sites, %zu blocks live, "
+          "%lld allocations not tracked\n",
+          site_cnt, block_cnt, untracked_cnt);
+  for (i = 0; i < site_cnt; i++)
+    printf ("  %p: %zu bytes live, %zu peak, %lld allocs, %lld frees\n",
+            sites[i].site, sites[i].live_bytes, sites[i].peak_bytes,
+            sites[i].alloc_cnt, sites[i].free_cnt);
+  printf ("Run `backtrace kernel.o' on these addresses to find the "
+          "call sites.\n");
+  malloc_print_stats ();
+
+  /* The table is no longer a hash table. */
+  allocprof_enabled = false;
+  sites = NULL;
+  blocks = NULL;
+}
+
+/* Returns a hash of pointer P in [0, CNT), where CNT is a power
+   of 2. */
+static size_t
+hash_ptr (const void *p, size_t cnt)
+{
+  uintptr_t x = (uintptr_t) p;
+
+  x ^= x >> 12;
+  return (x * 2654435761u) & (cnt - 1);
+}
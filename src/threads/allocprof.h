@@ -0,0 +1,17 @@
+#ifndef THREADS_ALLOCPROF_H
+#define THREADS_ALLOCPROF_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/* If false (default), allocations are not profiled.
+   If true, each allocation is charged to its call site.
+   Controlled by kernel command-line option "-ap". */
+extern bool allocprof_enabled;
+
+void allocprof_init (void);
+bool allocprof_alloc (void *block, size_t size, void *site);
+size_t allocprof_free (void *block);
+void allocprof_print_stats (void);
+
+#endif /* threads/allocprof.h */
@@ -15,6 +15,7 @@
 #include "devices/timer.h"
 #include "devices/vga.h"
 #include "devices/rtc.h"
+#include "threads/allocprof.h"
 #include "threads/interrupt.h"
 #include "threads/io.h"
 #include "threads/loader.h"
@@ -37,6 +38,13 @@
 #include "filesys/filesys.h"
 #include "filesys/fsutil.h"
 #endif
+#ifdef VM
+#include "vm/frame.h"
+#include "vm/merge.h"
+#include "vm/page.h"
+#include "vm/swap.h"
+#include "vm/wset.h"
+#endif
 
 /* Page directory with kernel mappings only. */
 uint32_t *init_page_dir;
@@ -54,11 +62,15 @@ static const char *swap_bdev_name;
 #endif
 #endif /* FILESYS */
 
+/* -ng: Leave global pages off, for comparison? */
+static bool no_global_pages;
+
 /* -ul: Maximum number of pages to put into palloc's user pool. */
 static size_t user_page_limit = SIZE_MAX;
 
 static void bss_init (void);
 static void paging_init (void);
+static uint32_t cpu_features (void);
 
 static char **read_command_line (void);
 static char **parse_options (char **argv);
@@ -96,8 +108,12 @@ main (void)
 
   /* Initialize memory system. */
   palloc_init (user_page_limit);
+  allocprof_init ();
   malloc_init ();
   paging_init ();
+#ifdef VM
+  frame_init ();
+#endif
 
   /* Segmentation. */
 #ifdef USERPROG
@@ -126,6 +142,12 @@ main (void)
   locate_block_devices ();
   filesys_init (format_filesys);
 #endif
+#ifdef VM
+  swap_init ();
+  frame_start_reclaim ();
+  wset_init ();
+  merge_init ();
+#endif
 
   printf ("Boot complete.\n");
   
@@ -150,16 +172,33 @@ bss_init (void)
   memset (&_start_bss, 0, &_end_bss - &_start_bss);
 }
 
+/* CPUID feature flags (leaf 1, EDX). */
+#define CPUID_PSE (1 << 3)              /* 4 MB pages. */
+#define CPUID_PGE (1 << 13)             /* Global pages. */
+
+/* CR4 bits. */
+#define CR4_PSE 0x00000010              /* Enable 4 MB pages. */
+#define CR4_PGE 0x00000080              /* Enable global pages. */
+
 /* Populates the base page directory and page table with the
    kernel virtual mapping, and then sets up the CPU to use the
    new page directory.  Points init_page_dir to the page
-   directory it creates. */
+   directory it creates.
+
+   If the CPU supports it, each 4 MB of RAM that is 4 MB aligned
+   and holds no kernel text is mapped with a single 4 MB page,
+   which saves a page table and lets one TLB entry cover it all.
+   The rest, notably the read-only kernel text, is mapped with
+   4 kB pages. */
 static void
 paging_init (void)
 {
   uint32_t *pd, *pt_;
   size_t page;
   extern char _start, _end_kernel_text;
+  uint32_t features = cpu_features ();
+  bool large = (features & CPUID_PSE) != 0;
+  uint32_t cr4 = 0;
 
   pd = init_page_dir = palloc_get_page (PAL_ASSERT | PAL_ZERO);
   pt_ = NULL;
@@ -173,6 +212,15 @@ paging_init (void)
 
       if (pd[pde_idx] == 0)
         {
+          char *end = vaddr + PTSPAN;
+          if (large && pte_idx == 0
+              && page + PTSPAN / PGSIZE <= init_ram_pages
+              && (end <= &_start || vaddr >= &_end_kernel_text))
+            {
+              pd[pde_idx] = pde_create_large (vaddr, true);
+              page += PTSPAN / PGSIZE - 1;
+              continue;
+            }
           pt_ = palloc_get_page (PAL_ASSERT | PAL_ZERO);
           pd[pde_idx] = pde_create (pt_);
         }
@@ -180,6 +228,23 @@ paging_init (void)
       pt_[pte_idx] = pte_create_kernel (vaddr, !in_kernel_text);
     }
 
+  /* Turn on 4 MB pages before loading a page directory that uses
+     them, and global pages so that the TLB entries for the kernel
+     mappings, which are marked global, survive the CR3 reload
+     done on every switch between processes.  See [IA32-v3a] 2.5
+     "Control Registers" and 3.11 "Translation Lookaside Buffers
+     (TLBs)". */
+  if (large)
+    cr4 |= CR4_PSE;
+  if ((features & CPUID_PGE) && !no_global_pages)
+    cr4 |= CR4_PGE;
+  if (cr4 != 0)
+    {
+      uint32_t old_cr4;
+      asm volatile ("movl %%cr4, %0" : "=r" (old_cr4));
+      asm volatile ("movl %0, %%cr4" : : "r" (old_cr4 | cr4) : "memory");
+    }
+
   /* Store the physical address of the page directory into CR3
      aka PDBR (page directory base register).  This activates our
      new page tables immediately.  See [IA32-v2a] "MOV--Move
@@ -188,6 +253,17 @@ paging_init (void)
   asm volatile ("movl %0, %%cr3" : : "r" (vtop (init_page_dir)));
 }
 
+/* Returns the feature flags reported by CPUID in EDX for leaf 1.
+   See [IA32-v2a] "CPUID--CPU Identification". */
+static uint32_t
+cpu_features (void)
+{
+  uint32_t eax = 1, ebx, ecx, edx;
+
+  asm ("cpuid" : "+a" (eax), "=b" (ebx), "=c" (ecx), "=d" (edx));
+  return edx;
+}
+
 /* Breaks the kernel command line into words and returns them as
    an argv-like array. */
 static char **
@@ -251,11 +327,37 @@ parse_options (char **argv)
       else if (!strcmp (name, "-swap"))
         swap_bdev_name = value;
 #endif
+#endif
+#ifdef VM
+      else if (!strcmp (name, "-sl"))
+        stack_page_limit = atoi (value);
+      else if (!strcmp (name, "-fa"))
+        fault_around_pages = atoi (value);
+      else if (!strcmp (name, "-ms"))
+        exit_memstat = true;
+      else if (!strcmp (name, "-zs"))
+        zcache_page_limit = atoi (value);
+      else if (!strcmp (name, "-mi"))
+        merge_interval = atoi (value);
+      else if (!strcmp (name, "-mf"))
+        merge_scan_frames = atoi (value);
+      else if (!strcmp (name, "-wi"))
+        wset_interval = atoi (value);
+      else if (!strcmp (name, "-ww"))
+        {
+          wset_window = atoi (value);
+          if (wset_window < 1 || wset_window > WSET_MAX_WINDOW)
+            PANIC ("-ww must be between 1 and %d", WSET_MAX_WINDOW);
+        }
 #endif
       else if (!strcmp (name, "-rs"))
         random_init (atoi (value));
       else if (!strcmp (name, "-mlfqs"))
         thread_mlfqs = true;
+      else if (!strcmp (name, "-ng"))
+        no_global_pages = true;
+      else if (!strcmp (name, "-ap"))
+        allocprof_enabled = true;
 #ifdef USERPROG
       else if (!strcmp (name, "-ul"))
         user_page_limit = atoi (value);
@@ -379,8 +481,22 @@ usage (void)
 #endif
           "  -rs=SEED           Set random number seed to SEED.\n"
           "  -mlfqs             Use multi-level feedback queue scheduler.\n"
+          "  -ng                Flush kernel TLB entries on process switches.\n"
+          "  -ap                Profile kernel allocations by call site.\n"
 #ifdef USERPROG
           "  -ul=COUNT          Limit user memory to COUNT pages.\n"
+#endif
+#ifdef VM
+          "  -sl=COUNT          Limit user stacks to COUNT pages.\n"
+          "  -fa=COUNT          Map up to COUNT pages around a page fault.\n"
+          "  -ms                Print memory statistics when a process exits.\n"
+          "  -zs=COUNT          Keep up to COUNT pages of compressed swap\n"
+          "                     in memory.\n"
+          "  -mi=TICKS          Scan for identical pages every TICKS ticks.\n"
+          "  -mf=COUNT          Scan COUNT frames each time (0 disables).\n"
+          "  -wi=TICKS          Sample accessed bits every TICKS ticks.\n"
+          "  -ww=COUNT          Count pages used in the last COUNT samples\n"
+          "                     as the working set (1 to 8).\n"
 #endif
           );
   shutdown_power_off ();
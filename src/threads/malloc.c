@@ -5,6 +5,7 @@
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
+#include "threads/allocprof.h"
 #include "threads/palloc.h"
 #include "threads/synch.h"
 #include "threads/vaddr.h"
@@ -12,10 +13,13 @@
 /* A simple implementation of malloc().
 
    The size of each request, in bytes, is rounded up to a power
-   of 2 and assigned to the "descriptor" that manages blocks of
-   that size.  The descriptor keeps a list of free blocks.  If
-   the free list is nonempty, one of its blocks is used to
-   satisfy the request.
+   of 2, or to the point halfway between two powers of 2, and
+   assigned to the "descriptor" that manages blocks of that size.
+   There are two descriptors per power of 2, so a request wastes
+   at most a third of its block, and the right descriptor can be
+   computed from the size directly (see size_to_desc()).  The
+   descriptor keeps a list of free blocks.  If the free list is
+   nonempty, one of its blocks is used to satisfy the request.
 
    Otherwise, a new page of memory, called an "arena", is
    obtained from the page allocator (if none is available,
@@ -26,7 +30,12 @@
    When we free a block, we add it to its descriptor's free list.
    But if the arena that the block was in now has no in-use
    blocks, we remove all of the arena's blocks from the free list
-   and give the arena back to the page allocator.
+   and give the arena back to the page allocator, unless the
+   descriptor has fewer than MALLOC_ARENA_RESERVE empty arenas
+   already.
+   Keeping a few empty arenas stops a program that allocates and
+   frees a single block over and over from passing a page back
+   and forth with the page allocator each time.
 
    We can't handle blocks bigger than 2 kB using this scheme,
    because they're too big to fit in a single page with a
@@ -40,9 +49,17 @@ struct desc
     size_t block_size;          /* Size of each element in bytes. */
     size_t blocks_per_arena;    /* Number of blocks in an arena. */
     struct list free_list;      /* List of free blocks. */
+    size_t empty_cnt;           /* Arenas with no blocks in use. */
+    size_t arena_cnt;           /* Arenas in all. */
+    size_t new_cnt;             /* Arenas ever obtained. */
+    size_t requested;           /* Bytes requested, when profiling. */
     struct lock lock;           /* Lock. */
   };
 
+/* Empty arenas kept by each descriptor.  0 gives every empty
+   arena back at once. */
+size_t malloc_arena_reserve = 1;
+
 /* Magic number for detecting arena corruption. */
 #define ARENA_MAGIC 0x9a548eed
 
@@ -61,9 +78,12 @@ struct block
   };
 
 /* Our set of descriptors. */
-static struct desc descs[10];   /* Descriptors. */
+static struct desc descs[16];   /* Descriptors. */
 static size_t desc_cnt;         /* Number of descriptors. */
 
+static void *malloc_block (size_t size);
+static void profile_alloc (void *block, size_t size, void *site);
+static struct desc *size_to_desc (size_t size);
 static struct arena *block_to_arena (struct block *);
 static struct block *arena_to_block (struct arena *, size_t idx);
 
@@ -73,14 +93,22 @@ malloc_init (void)
 {
   size_t block_size;
 
-  for (block_size = 16; block_size < PGSIZE / 2; block_size *= 2)
+  /* 16, 24, 32, 48, 64, ..., 1024, 1536. */
+  for (block_size = 16; block_size < PGSIZE / 2;
+       block_size += block_size & (block_size - 1) ? block_size / 3
+                                                    : block_size / 2)
     {
       struct desc *d = &descs[desc_cnt++];
       ASSERT (desc_cnt <= sizeof descs / sizeof *descs);
       d->block_size = block_size;
       d->blocks_per_arena = (PGSIZE - sizeof (struct arena)) / block_size;
       list_init (&d->free_list);
+      d->empty_cnt = 0;
+      d->arena_cnt = 0;
+      d->new_cnt = 0;
+      d->requested = 0;
       lock_init (&d->lock);
+      ASSERT (size_to_desc (block_size) == d);
     }
 }
 
@@ -88,6 +116,17 @@ malloc_init (void)
    Returns a null pointer if memory is not available. */
 void *
 malloc (size_t size) 
+{
+  void *p = malloc_block (size);
+
+  if (allocprof_enabled)
+    profile_alloc (p, size, __builtin_return_address (0));
+  return p;
+}
+
+/* Does the work of malloc(), without profiling. */
+static void *
+malloc_block (size_t size) 
 {
   struct desc *d;
   struct block *b;
@@ -99,15 +138,13 @@ malloc (size_t size)
 
   /* Find the smallest descriptor that satisfies a SIZE-byte
      request. */
-  for (d = descs; d < descs + desc_cnt; d++)
-    if (d->block_size >= size)
-      break;
-  if (d == descs + desc_cnt) 
+  d = size_to_desc (size);
+  if (d == NULL) 
     {
       /* SIZE is too big for any descriptor.
          Allocate enough pages to hold SIZE plus an arena. */
       size_t page_cnt = DIV_ROUND_UP (size + sizeof *a, PGSIZE);
-      a = palloc_get_multiple (0, page_cnt);
+      a = palloc_get_multiple (PAL_NOPROF, page_cnt);
       if (a == NULL)
         return NULL;
 
@@ -127,7 +164,7 @@ malloc (size_t size)
       size_t i;
 
       /* Allocate a page. */
-      a = palloc_get_page (0);
+      a = palloc_get_page (PAL_NOPROF);
       if (a == NULL) 
         {
           lock_release (&d->lock);
@@ -143,12 +180,16 @@ malloc (size_t size)
           struct block *b = arena_to_block (a, i);
           list_push_back (&d->free_list, &b->free_elem);
         }
+      d->arena_cnt++;
+      d->new_cnt++;
+      d->empty_cnt++;
     }
 
   /* Get a block from free list and return it. */
   b = list_entry (list_pop_front (&d->free_list), struct block, free_elem);
   a = block_to_arena (b);
-  a->free_cnt--;
+  if (a->free_cnt-- == d->blocks_per_arena)
+    d->empty_cnt--;
   lock_release (&d->lock);
   return b;
 }
@@ -167,7 +208,9 @@ calloc (size_t a, size_t b)
     return NULL;
 
   /* Allocate and zero memory. */
-  p = malloc (size);
+  p = malloc_block (size);
+  if (allocprof_enabled)
+    profile_alloc (p, size, __builtin_return_address (0));
   if (p != NULL)
     memset (p, 0, size);
 
@@ -201,7 +244,9 @@ realloc (void *old_block, size_t new_size)
     }
   else 
     {
-      void *new_block = malloc (new_size);
+      void *new_block = malloc_block (new_size);
+      if (allocprof_enabled)
+        profile_alloc (new_block, new_size, __builtin_return_address (0));
       if (old_block != NULL && new_block != NULL)
         {
           size_t old_size = block_size (old_block);
@@ -223,6 +268,7 @@ free (void *p)
       struct block *b = p;
       struct arena *a = block_to_arena (b);
       struct desc *d = a->desc;
+      size_t requested = allocprof_enabled ? allocprof_free (p) : 0;
       
       if (d != NULL) 
         {
@@ -234,22 +280,30 @@ free (void *p)
 #endif
   
           lock_acquire (&d->lock);
+          d->requested -= requested;
 
           /* Add block to free list. */
           list_push_front (&d->free_list, &b->free_elem);
 
-          /* If the arena is now entirely unused, free it. */
+          /* If the arena is now entirely unused, keep it in
+             reserve or free it. */
           if (++a->free_cnt >= d->blocks_per_arena) 
             {
-              size_t i;
-
               ASSERT (a->free_cnt == d->blocks_per_arena);
-              for (i = 0; i < d->blocks_per_arena; i++) 
+              if (d->empty_cnt < malloc_arena_reserve)
+                d->empty_cnt++;
+              else
                 {
-                  struct block *b = arena_to_block (a, i);
-                  list_remove (&b->free_elem);
+                  size_t i;
+
+                  for (i = 0; i < d->blocks_per_arena; i++) 
+                    {
+                      struct block *b = arena_to_block (a, i);
+                      list_remove (&b->free_elem);
+                    }
+                  d->arena_cnt--;
+                  palloc_free_page (a);
                 }
-              palloc_free_page (a);
             }
 
           lock_release (&d->lock);
@@ -263,6 +317,112 @@ free (void *p)
     }
 }
 
+/* Returns the number of arenas, that is, pages used for blocks
+   smaller than a page, that malloc() currently holds. */
+size_t
+malloc_arena_cnt (void)
+{
+  size_t arena_cnt = 0;
+  size_t i;
+
+  for (i = 0; i < desc_cnt; i++)
+    arena_cnt += descs[i].arena_cnt;
+  return arena_cnt;
+}
+
+/* Returns the number of arenas that malloc() has obtained from
+   the page allocator since startup, including those it has
+   given back. */
+size_t
+malloc_arena_new_cnt (void)
+{
+  size_t new_cnt = 0;
+  size_t i;
+
+  for (i = 0; i < desc_cnt; i++)
+    new_cnt += descs[i].new_cnt;
+  return new_cnt;
+}
+
+/* Returns the size of the block that malloc() hands out for a
+   SIZE-byte request, or 0 if SIZE is too big for any descriptor
+   and gets pages of its own. */
+size_t
+malloc_block_size (size_t size)
+{
+  struct desc *d = size_to_desc (size);
+
+  return d != NULL ? d->block_size : 0;
+}
+
+/* Prints the use of each descriptor's arenas: how many blocks
+   are in use and, if profiling is enabled, how much of them was
+   requested. */
+void
+malloc_print_stats (void)
+{
+  size_t i;
+
+  for (i = 0; i < desc_cnt; i++)
+    {
+      struct desc *d = &descs[i];
+      size_t used_cnt, used_bytes;
+
+      lock_acquire (&d->lock);
+      used_cnt = d->arena_cnt * d->blocks_per_arena
+                 - list_size (&d->free_list);
+      used_bytes = used_cnt * d->block_size;
+      printf ("Malloc: %4zu-byte blocks: %zu arenas, %zu blocks in use",
+              d->block_size, d->arena_cnt, used_cnt);
+      if (allocprof_enabled && used_bytes > 0)
+        printf (", %zu bytes requested (%zu%%)",
+                d->requested, d->requested * 100 / used_bytes);
+      printf ("\n");
+      lock_release (&d->lock);
+    }
+}
+
+/* Charges BLOCK, SIZE bytes long, to the call site SITE, and if
+   it is a small block, to its descriptor. */
+static void
+profile_alloc (void *block, size_t size, void *site)
+{
+  if (allocprof_alloc (block, size, site))
+    {
+      struct desc *d = block_to_arena (block)->desc;
+      if (d != NULL)
+        {
+          lock_acquire (&d->lock);
+          d->requested += size;
+          lock_release (&d->lock);
+        }
+    }
+}
+
+/* Returns the descriptor for SIZE-byte blocks, or a null
+   pointer if SIZE is too big for any descriptor.
+
+   Blocks of 2**K bytes use descriptor 2*K - 8, and blocks of
+   3 * 2**(K-2) bytes, halfway between 2**(K-1) and 2**K, use
+   descriptor 2*K - 9.  A size whose highest bit, after
+   subtracting 1, is bit K-1 rounds up to the halfway point if
+   its next bit is clear, and to 2**K otherwise. */
+static struct desc *
+size_to_desc (size_t size)
+{
+  size_t idx;
+
+  if (size <= 16)
+    idx = 0;
+  else
+    {
+      size_t s = size - 1;
+      int k = 31 - __builtin_clz (s);
+      idx = 2 * k - 7 + ((s >> (k - 1)) & 1);
+    }
+  return idx < desc_cnt ? &descs[idx] : NULL;
+}
+
 /* Returns the arena that block B is inside. */
 static struct arena *
 block_to_arena (struct block *b)
@@ -4,10 +4,16 @@
 #include <debug.h>
 #include <stddef.h>
 
+extern size_t malloc_arena_reserve;
+
 void malloc_init (void);
 void *malloc (size_t) __attribute__ ((malloc));
 void *calloc (size_t, size_t) __attribute__ ((malloc));
 void *realloc (void *, size_t);
 void free (void *);
+size_t malloc_arena_cnt (void);
+size_t malloc_arena_new_cnt (void);
+size_t malloc_block_size (size_t);
+void malloc_print_stats (void);
 
 #endif /* threads/malloc.h */
@@ -1,14 +1,15 @@
 #include "threads/palloc.h"
-#include <bitmap.h>
 #include <debug.h>
 #include <inttypes.h>
+#include <list.h>
 #include <round.h>
 #include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
+#include "threads/allocprof.h"
+#include "threads/interrupt.h"
 #include "threads/loader.h"
-#include "threads/synch.h"
 #include "threads/vaddr.h"
 
 /* Page allocator.  Hands out memory in page-size (or
@@ -21,24 +22,113 @@
    that the kernel needs to have memory for its own operations
    even if user processes are swapping like mad.
 
-   By default, half of system RAM is given to the kernel pool and
-   half to the user pool.  That should be huge overkill for the
-   kernel pool, but that's just fine for demonstration purposes. */
+   At startup, half of system RAM is given to the kernel pool and
+   half to the user pool.  After that, the boundary moves with
+   demand.  Memory is divided into "chunks" of CHUNK_PAGES pages,
+   each owned by one pool, and a chunk that is entirely free can
+   be handed over to the other pool.  A pool that falls below its
+   low watermark takes a chunk from the other pool if that one
+   has more than its high watermark free, and a pool that has
+   nothing left for a request takes chunks from the other pool
+   for as long as that one stays above its low watermark.  So
+   neither pool runs out while the other has memory to spare.
+
+   Each pool is a binary buddy system.  Its free pages are kept
+   in blocks of 2**K pages, for K from 0 to MAX_ORDER, each
+   aligned to its own size relative to the base of memory, on the
+   pool's free list for order K.  Blocks of CHUNK_ORDER and more
+   consist of whole chunks, and are only merged with buddies
+   owned by the same pool.  A block is linked into its list through a
+   `struct list_elem' stored in its first page, so the only other
+   bookkeeping is one byte per page in PAGE_INFO.  A request for
+   N pages takes a block of the smallest order that fits,
+   splitting a larger block if needed, and gives back the pages
+   beyond N right away.  A request for more than 2**MAX_ORDER
+   pages takes a run of adjacent free blocks of MAX_ORDER found by
+   scanning that free list instead.  A freed block is merged with its
+   "buddy", the other half of the block of the next order, for as
+   long as the buddy is free as well.  So a single page is
+   allocated in constant time and order K in O(MAX_ORDER - K).
+
+   The pools are protected by turning interrupts off rather than
+   with a lock, because the scheduler frees a dying thread's page
+   from a context in which it cannot sleep (see
+   thread_schedule_tail()).  Every operation is short.
+
+   Each pool also keeps a small cache of single pages that are
+   already zeroed.  The idle thread fills it by calling
+   palloc_refill_zeroed() when nothing else wants to run, and
+   PAL_ZERO requests for one page are served from it first, so
+   that the memset() stays off the paths of thread_create(),
+   pagedir_create() and the like, and, in the user pool, of
+   faults on anonymous pages (see frame_alloc_zeroed()).  Cached
+   pages count as allocated; they are given back when a pool runs
+   dry. */
+
+/* Largest block order: 2**10 pages is 4 MB. */
+#define MAX_ORDER 10
+
+/* Chunks, the unit moved between pools: 2**6 pages is 256 kB. */
+#define CHUNK_ORDER 6
+#define CHUNK_PAGES (1u << CHUNK_ORDER)
+
+/* PAGE_INFO bits. */
+#define PAGE_FREE 0x80                  /* First page of a free block. */
+#define PAGE_ORDER 0x7f                 /* The free block's order. */
+
+/* Pre-zeroed pages kept per pool. */
+#define ZEROED_MAX 32
 
 /* A memory pool. */
 struct pool
   {
-    struct lock lock;                   /* Mutual exclusion. */
-    struct bitmap *used_map;            /* Bitmap of free pages. */
-    uint8_t *base;                      /* Base of pool. */
+    const char *name;                   /* Name, for statistics. */
+    size_t page_cnt;                    /* Number of pages owned. */
+    size_t max_pages;                   /* Most pages it may own. */
+    struct list free_lists[MAX_ORDER + 1]; /* Free blocks by order. */
+    size_t free_cnt[MAX_ORDER + 1];     /* Length of each free list. */
+    size_t free_pages;                  /* Pages in free blocks. */
+    struct pool *other;                 /* The other pool. */
+
+    /* Rebalancing. */
+    size_t low_water;                   /* Take chunks below this. */
+    size_t high_water;                  /* Give chunks above this. */
+    long long chunks_in;                /* Chunks taken. */
+    long long chunks_out;               /* Chunks given. */
+    long long low_cnt;                  /* Times fallen below LOW_WATER. */
+    long long fail_cnt;                 /* Requests that failed. */
+
+    /* Pre-zeroed pages. */
+    void *zeroed[ZEROED_MAX];           /* Zeroed pages, allocated. */
+    size_t zeroed_cnt;                  /* Number of pages in ZEROED. */
+    long long zero_hit_cnt;             /* PAL_ZERO pages from ZEROED. */
+    long long zero_miss_cnt;            /* PAL_ZERO pages zeroed inline. */
+    long long refill_cnt;               /* Pages zeroed by idle thread. */
   };
 
 /* Two pools: one for kernel data, one for user pages. */
 static struct pool kernel_pool, user_pool;
 
-static void init_pool (struct pool *, void *base, size_t page_cnt,
-                       const char *name);
-static bool page_from_pool (const struct pool *, void *page);
+/* Memory shared by the pools. */
+static uint8_t *mem_base;               /* First page. */
+static size_t mem_page_cnt;             /* Number of pages. */
+static uint8_t *page_info;              /* PAGE_* bits for each page. */
+static struct pool **chunk_owner;       /* Owner of each chunk. */
+
+static void init_pool (struct pool *, const char *name,
+                       size_t first_page, size_t page_cnt,
+                       size_t max_pages);
+static void *get_pages (enum palloc_flags, size_t page_cnt);
+static struct pool *page_to_pool (void *page);
+static bool move_chunk (struct pool *from, struct pool *to, size_t keep);
+static size_t alloc_pages (struct pool *, size_t page_cnt, unsigned order);
+static size_t alloc_block (struct pool *, unsigned order);
+static size_t alloc_run (struct pool *, size_t page_cnt);
+static void free_block (struct pool *, size_t page_idx, unsigned order);
+static void free_range (struct pool *, size_t page_idx, size_t page_cnt);
+static bool release_zeroed (struct pool *);
+static bool refill_zeroed (struct pool *);
+static void print_pool_stats (const struct pool *);
 
 /* Initializes the page allocator.  At most USER_PAGE_LIMIT
    pages are put into the user pool. */
@@ -49,16 +139,40 @@ palloc_init (size_t user_page_limit)
   uint8_t *free_start = ptov (1024 * 1024);
   uint8_t *free_end = ptov (init_ram_pages * PGSIZE);
   size_t free_pages = (free_end - free_start) / PGSIZE;
-  size_t user_pages = free_pages / 2;
-  size_t kernel_pages;
+  size_t chunk_cnt = DIV_ROUND_UP (free_pages, CHUNK_PAGES);
+  size_t user_pages, kernel_pages;
+
+  /* We'll put the page info and chunk owners at the base of
+     memory, the chunk owners past a byte of page info for every
+     free page, aligned for a pointer.  Calculate the space needed
+     for them and subtract it from the memory to hand out. */
+  size_t owner_ofs = ROUND_UP (free_pages, __alignof__ (struct pool *));
+  size_t info_pages = DIV_ROUND_UP (owner_ofs
+                                    + chunk_cnt * sizeof *chunk_owner,
+                                    PGSIZE);
+  if (info_pages >= free_pages)
+    PANIC ("Not enough memory for page info.");
+  mem_page_cnt = free_pages - info_pages;
+  page_info = free_start;
+  chunk_owner = (struct pool **) (page_info + owner_ofs);
+  mem_base = free_start + info_pages * PGSIZE;
+  memset (page_info, 0, mem_page_cnt);
+
+  /* Give half of memory to kernel, half to user, in whole
+     chunks. */
+  user_pages = mem_page_cnt / 2;
   if (user_pages > user_page_limit)
     user_pages = user_page_limit;
-  kernel_pages = free_pages - user_pages;
+  kernel_pages = ROUND_UP (mem_page_cnt - user_pages, CHUNK_PAGES);
+  if (kernel_pages > mem_page_cnt)
+    kernel_pages = mem_page_cnt;
+  user_pages = mem_page_cnt - kernel_pages;
 
-  /* Give half of memory to kernel, half to user. */
-  init_pool (&kernel_pool, free_start, kernel_pages, "kernel pool");
-  init_pool (&user_pool, free_start + kernel_pages * PGSIZE,
-             user_pages, "user pool");
+  kernel_pool.other = &user_pool;
+  user_pool.other = &kernel_pool;
+  init_pool (&kernel_pool, "kernel pool", 0, kernel_pages, SIZE_MAX);
+  init_pool (&user_pool, "user pool", kernel_pages, user_pages,
+             user_page_limit);
 }
 
 /* Obtains and returns a group of PAGE_CNT contiguous free pages.
@@ -69,22 +183,63 @@ palloc_init (size_t user_page_limit)
    FLAGS, in which case the kernel panics. */
 void *
 palloc_get_multiple (enum palloc_flags flags, size_t page_cnt)
+{
+  void *pages = get_pages (flags, page_cnt);
+
+  if (allocprof_enabled && !(flags & PAL_NOPROF))
+    allocprof_alloc (pages, PGSIZE * page_cnt, __builtin_return_address (0));
+  return pages;
+}
+
+/* Does the work of palloc_get_multiple(), without profiling. */
+static void *
+get_pages (enum palloc_flags flags, size_t page_cnt)
 {
   struct pool *pool = flags & PAL_USER ? &user_pool : &kernel_pool;
-  void *pages;
+  void *pages = NULL;
+  enum intr_level old_level;
+  unsigned order;
   size_t page_idx;
 
   if (page_cnt == 0)
     return NULL;
 
-  lock_acquire (&pool->lock);
-  page_idx = bitmap_scan_and_flip (pool->used_map, 0, page_cnt, false);
-  lock_release (&pool->lock);
+  /* ORDER is MAX_ORDER + 1 if no single block is large enough. */
+  for (order = 0; order <= MAX_ORDER && (1u << order) < page_cnt; order++)
+    continue;
 
-  if (page_idx != BITMAP_ERROR)
-    pages = pool->base + PGSIZE * page_idx;
+  old_level = intr_disable ();
+  if (page_cnt == 1 && (flags & PAL_ZERO) && pool->zeroed_cnt > 0)
+    {
+      pages = pool->zeroed[--pool->zeroed_cnt];
+      pool->zero_hit_cnt++;
+      flags &= ~PAL_ZERO;
+    }
   else
-    pages = NULL;
+    {
+      page_idx = alloc_pages (pool, page_cnt, order);
+      if (page_idx == SIZE_MAX && release_zeroed (pool))
+        page_idx = alloc_pages (pool, page_cnt, order);
+      while (page_idx == SIZE_MAX
+             && move_chunk (pool->other, pool, pool->other->low_water))
+        page_idx = alloc_pages (pool, page_cnt, order);
+      if (page_idx != SIZE_MAX)
+        {
+          pages = mem_base + PGSIZE * page_idx;
+          if (flags & PAL_ZERO)
+            pool->zero_miss_cnt += page_cnt;
+        }
+      else
+        pool->fail_cnt++;
+    }
+
+  /* Top up from the other pool before running dry. */
+  if (pool->free_pages < pool->low_water)
+    {
+      pool->low_cnt++;
+      move_chunk (pool->other, pool, pool->other->high_water);
+    }
+  intr_set_level (old_level);
 
   if (pages != NULL) 
     {
@@ -110,7 +265,11 @@ palloc_get_multiple (enum palloc_flags flags, size_t page_cnt)
 void *
 palloc_get_page (enum palloc_flags flags) 
 {
-  return palloc_get_multiple (flags, 1);
+  void *page = get_pages (flags, 1);
+
+  if (allocprof_enabled && !(flags & PAL_NOPROF))
+    allocprof_alloc (page, PGSIZE, __builtin_return_address (0));
+  return page;
 }
 
 /* Frees the PAGE_CNT pages starting at PAGES. */
@@ -118,27 +277,29 @@ void
 palloc_free_multiple (void *pages, size_t page_cnt) 
 {
   struct pool *pool;
+  enum intr_level old_level;
   size_t page_idx;
 
   ASSERT (pg_ofs (pages) == 0);
   if (pages == NULL || page_cnt == 0)
     return;
 
-  if (page_from_pool (&kernel_pool, pages))
-    pool = &kernel_pool;
-  else if (page_from_pool (&user_pool, pages))
-    pool = &user_pool;
-  else
-    NOT_REACHED ();
+  if (allocprof_enabled)
+    allocprof_free (pages);
 
-  page_idx = pg_no (pages) - pg_no (pool->base);
+  pool = page_to_pool (pages);
+  page_idx = pg_no (pages) - pg_no (mem_base);
+  ASSERT (page_idx + page_cnt <= mem_page_cnt);
+  ASSERT (page_to_pool (pages + PGSIZE * (page_cnt - 1)) == pool);
+  ASSERT (!(page_info[page_idx] & PAGE_FREE));
 
 #ifndef NDEBUG
   memset (pages, 0xcc, PGSIZE * page_cnt);
 #endif
 
-  ASSERT (bitmap_all (pool->used_map, page_idx, page_cnt));
-  bitmap_set_multiple (pool->used_map, page_idx, page_cnt, false);
+  old_level = intr_disable ();
+  free_range (pool, page_idx, page_cnt);
+  intr_set_level (old_level);
 }
 
 /* Frees the page at PAGE. */
@@ -148,35 +309,351 @@ palloc_free_page (void *page)
   palloc_free_multiple (page, 1);
 }
 
-/* Initializes pool P as starting at START and ending at END,
-   naming it NAME for debugging purposes. */
+/* Zeroes a page for the pre-zeroed cache of a pool that is
+   short of them.  Returns true if it did, false if the caches
+   are full or no page could be had.  Called by the idle thread;
+   each call does one page's worth of work, so that the caller
+   can stop as soon as another thread becomes ready. */
+bool
+palloc_refill_zeroed (void)
+{
+  return refill_zeroed (&kernel_pool) || refill_zeroed (&user_pool);
+}
+
+/* Returns the number of pages that PAL_USER requests can still
+   obtain: those free in the user pool, plus those the user pool
+   may take from the kernel pool when it runs out. */
+size_t
+palloc_user_available (void)
+{
+  const struct pool *k = &kernel_pool;
+  const struct pool *u = &user_pool;
+  enum intr_level old_level;
+  size_t avail, spare;
+
+  old_level = intr_disable ();
+  avail = u->free_pages + u->zeroed_cnt;
+  spare = k->free_pages > k->low_water ? k->free_pages - k->low_water : 0;
+  spare = ROUND_DOWN (spare, CHUNK_PAGES);
+  if (spare > u->max_pages - u->page_cnt)
+    spare = ROUND_DOWN (u->max_pages - u->page_cnt, CHUNK_PAGES);
+  intr_set_level (old_level);
+  return avail + spare;
+}
+
+/* Prints page allocator statistics. */
+void
+palloc_print_stats (void)
+{
+  print_pool_stats (&kernel_pool);
+  print_pool_stats (&user_pool);
+}
+
+/* Initializes pool P, naming it NAME for debugging purposes,
+   with the PAGE_CNT pages starting at FIRST_PAGE, and allowing it
+   to grow to MAX_PAGES. */
 static void
-init_pool (struct pool *p, void *base, size_t page_cnt, const char *name) 
+init_pool (struct pool *p, const char *name,
+           size_t first_page, size_t page_cnt, size_t max_pages)
 {
-  /* We'll put the pool's used_map at its base.
-     Calculate the space needed for the bitmap
-     and subtract it from the pool's size. */
-  size_t bm_pages = DIV_ROUND_UP (bitmap_buf_size (page_cnt), PGSIZE);
-  if (bm_pages > page_cnt)
-    PANIC ("Not enough memory in %s for bitmap.", name);
-  page_cnt -= bm_pages;
+  unsigned order;
+  size_t i;
 
   printf ("%zu pages available in %s.\n", page_cnt, name);
 
-  /* Initialize the pool. */
-  lock_init (&p->lock);
-  p->used_map = bitmap_create_in_buf (page_cnt, base, bm_pages * PGSIZE);
-  p->base = base + bm_pages * PGSIZE;
+  p->name = name;
+  p->page_cnt = page_cnt;
+  p->max_pages = max_pages;
+  for (order = 0; order <= MAX_ORDER; order++)
+    {
+      list_init (&p->free_lists[order]);
+      p->free_cnt[order] = 0;
+    }
+  p->free_pages = 0;
+  p->low_water = page_cnt / 32;
+  p->high_water = page_cnt / 16;
+  p->chunks_in = p->chunks_out = p->low_cnt = p->fail_cnt = 0;
+  p->zeroed_cnt = 0;
+  p->zero_hit_cnt = p->zero_miss_cnt = p->refill_cnt = 0;
+
+  for (i = first_page; i < first_page + page_cnt; i += CHUNK_PAGES)
+    chunk_owner[i >> CHUNK_ORDER] = p;
+  free_range (p, first_page, page_cnt);
 }
 
-/* Returns true if PAGE was allocated from POOL,
-   false otherwise. */
+/* Returns the pool that owns PAGE. */
+static struct pool *
+page_to_pool (void *page)
+{
+  size_t page_idx = pg_no (page) - pg_no (mem_base);
+
+  ASSERT ((uint8_t *) page >= mem_base && page_idx < mem_page_cnt);
+  return chunk_owner[page_idx >> CHUNK_ORDER];
+}
+
+/* Moves one free chunk from pool FROM to pool TO, as long as
+   FROM keeps at least KEEP free pages and TO does not grow past
+   its limit.  Returns true if successful. */
 static bool
-page_from_pool (const struct pool *pool, void *page) 
+move_chunk (struct pool *from, struct pool *to, size_t keep)
 {
-  size_t page_no = pg_no (page);
-  size_t start_page = pg_no (pool->base);
-  size_t end_page = start_page + bitmap_size (pool->used_map);
+  size_t page_idx;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (from->free_pages < keep + CHUNK_PAGES
+      || to->page_cnt + CHUNK_PAGES > to->max_pages)
+    return false;
+
+  page_idx = alloc_block (from, CHUNK_ORDER);
+  if (page_idx == SIZE_MAX)
+    return false;
+  from->page_cnt -= CHUNK_PAGES;
+  from->chunks_out++;
 
-  return page_no >= start_page && page_no < end_page;
+  chunk_owner[page_idx >> CHUNK_ORDER] = to;
+  to->page_cnt += CHUNK_PAGES;
+  to->chunks_in++;
+  free_block (to, page_idx, CHUNK_ORDER);
+  return true;
+}
+
+/* Returns the list element stored in the first page of the block
+   at PAGE_IDX. */
+static struct list_elem *
+block_elem (size_t page_idx)
+{
+  return (struct list_elem *) (mem_base + PGSIZE * page_idx);
+}
+
+/* Puts the free block of 2**ORDER pages at PAGE_IDX on POOL's
+   free list for ORDER. */
+static void
+push_block (struct pool *pool, size_t page_idx, unsigned order)
+{
+  page_info[page_idx] = PAGE_FREE | order;
+  list_push_front (&pool->free_lists[order], block_elem (page_idx));
+  pool->free_cnt[order]++;
+  pool->free_pages += (size_t) 1 << order;
+}
+
+/* Takes the free block of 2**ORDER pages at PAGE_IDX off POOL's
+   free list for ORDER. */
+static void
+remove_block (struct pool *pool, size_t page_idx, unsigned order)
+{
+  ASSERT (page_info[page_idx] == (PAGE_FREE | order));
+
+  page_info[page_idx] = 0;
+  list_remove (block_elem (page_idx));
+  pool->free_cnt[order]--;
+  pool->free_pages -= (size_t) 1 << order;
+}
+
+/* Allocates PAGE_CNT pages from POOL, ORDER being the order of
+   the smallest block that holds them, or MAX_ORDER + 1 if no
+   block does.  Returns the first page index, or SIZE_MAX if no
+   free memory is large enough. */
+static size_t
+alloc_pages (struct pool *pool, size_t page_cnt, unsigned order)
+{
+  size_t page_idx;
+
+  if (order > MAX_ORDER)
+    return alloc_run (pool, page_cnt);
+
+  page_idx = alloc_block (pool, order);
+  if (page_idx != SIZE_MAX)
+    free_range (pool, page_idx + page_cnt, ((size_t) 1 << order) - page_cnt);
+  return page_idx;
+}
+
+/* Allocates a block of 2**ORDER pages from POOL, splitting a
+   larger free block if there is no free block of that order.
+   Returns the block's first page index, or SIZE_MAX if no block
+   is large enough. */
+static size_t
+alloc_block (struct pool *pool, unsigned order)
+{
+  unsigned k;
+  size_t page_idx;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  for (k = order; k <= MAX_ORDER; k++)
+    if (!list_empty (&pool->free_lists[k]))
+      break;
+  if (k > MAX_ORDER)
+    return SIZE_MAX;
+
+  page_idx = (((uint8_t *) list_front (&pool->free_lists[k]) - mem_base)
+              / PGSIZE);
+  remove_block (pool, page_idx, k);
+
+  /* Give back the upper half until the block is the right size. */
+  while (k > order)
+    {
+      k--;
+      push_block (pool, page_idx + ((size_t) 1 << k), k);
+    }
+  return page_idx;
+}
+
+/* Allocates PAGE_CNT pages, more than a block of MAX_ORDER holds,
+   from POOL as a run of adjacent free blocks of MAX_ORDER, and
+   gives back the pages of the last block beyond PAGE_CNT.
+   Returns the run's first page index, or SIZE_MAX if POOL has no
+   such run. */
+static size_t
+alloc_run (struct pool *pool, size_t page_cnt)
+{
+  struct list *list = &pool->free_lists[MAX_ORDER];
+  size_t block_pages = (size_t) 1 << MAX_ORDER;
+  size_t block_cnt = DIV_ROUND_UP (page_cnt, block_pages);
+  struct list_elem *e;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (pool->free_cnt[MAX_ORDER] < block_cnt)
+    return SIZE_MAX;
+
+  for (e = list_begin (list); e != list_end (list); e = list_next (e))
+    {
+      size_t page_idx = ((uint8_t *) e - mem_base) / PGSIZE;
+      size_t i;
+
+      for (i = 1; i < block_cnt; i++)
+        {
+          size_t block_idx = page_idx + i * block_pages;
+
+          if (block_idx + block_pages > mem_page_cnt
+              || page_info[block_idx] != (PAGE_FREE | MAX_ORDER)
+              || chunk_owner[block_idx >> CHUNK_ORDER] != pool)
+            break;
+        }
+      if (i == block_cnt)
+        {
+          for (i = 0; i < block_cnt; i++)
+            remove_block (pool, page_idx + i * block_pages, MAX_ORDER);
+          free_range (pool, page_idx + page_cnt,
+                      block_cnt * block_pages - page_cnt);
+          return page_idx;
+        }
+    }
+  return SIZE_MAX;
+}
+
+/* Frees the block of 2**ORDER pages at PAGE_IDX in POOL, merging
+   it with its buddy for as long as the buddy is free too and, if
+   it lies in another chunk, owned by POOL. */
+static void
+free_block (struct pool *pool, size_t page_idx, unsigned order)
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  for (; order < MAX_ORDER; order++)
+    {
+      size_t size = (size_t) 1 << order;
+      size_t buddy_idx = page_idx ^ size;
+
+      if (buddy_idx + size > mem_page_cnt
+          || page_info[buddy_idx] != (PAGE_FREE | order)
+          || chunk_owner[buddy_idx >> CHUNK_ORDER] != pool)
+        break;
+      remove_block (pool, buddy_idx, order);
+      page_idx &= ~size;
+    }
+  push_block (pool, page_idx, order);
+}
+
+/* Frees the PAGE_CNT pages starting at PAGE_IDX in POOL, in the
+   largest aligned blocks they split into. */
+static void
+free_range (struct pool *pool, size_t page_idx, size_t page_cnt)
+{
+  while (page_cnt > 0)
+    {
+      unsigned order = 0;
+
+      while (order < MAX_ORDER
+             && page_idx % ((size_t) 2 << order) == 0
+             && ((size_t) 2 << order) <= page_cnt)
+        order++;
+      free_block (pool, page_idx, order);
+      page_idx += (size_t) 1 << order;
+      page_cnt -= (size_t) 1 << order;
+    }
+}
+
+/* Prints POOL's free page count and its number of free blocks of
+   each order. */
+static void
+print_pool_stats (const struct pool *pool)
+{
+  unsigned order;
+
+  printf ("Palloc: %s: %zu of %zu pages free, free blocks by order:",
+          pool->name, pool->free_pages, pool->page_cnt);
+  for (order = 0; order <= MAX_ORDER; order++)
+    printf (" %zu", pool->free_cnt[order]);
+  printf ("\n");
+  printf ("Palloc: %s: %lld zeroed pages from cache, %lld zeroed inline, "
+          "%lld zeroed while idle\n",
+          pool->name, pool->zero_hit_cnt, pool->zero_miss_cnt,
+          pool->refill_cnt);
+  printf ("Palloc: %s: %lld chunks taken, %lld given, "
+          "%lld times below low watermark (%zu pages), "
+          "%lld requests failed\n",
+          pool->name, pool->chunks_in, pool->chunks_out, pool->low_cnt,
+          pool->low_water, pool->fail_cnt);
+}
+
+/* Gives POOL's pre-zeroed pages back to its free lists.
+   Returns true if there were any. */
+static bool
+release_zeroed (struct pool *pool)
+{
+  bool released = pool->zeroed_cnt > 0;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  while (pool->zeroed_cnt > 0)
+    {
+      uint8_t *page = pool->zeroed[--pool->zeroed_cnt];
+      free_range (pool, (page - mem_base) / PGSIZE, 1);
+    }
+  return released;
+}
+
+/* Adds one zeroed page to POOL's pre-zeroed cache, if it is not
+   full and a page is free.  Returns true if successful. */
+static bool
+refill_zeroed (struct pool *pool)
+{
+  enum intr_level old_level;
+  size_t page_idx;
+  uint8_t *page;
+
+  old_level = intr_disable ();
+  page_idx = (pool->zeroed_cnt < ZEROED_MAX
+              ? alloc_block (pool, 0) : SIZE_MAX);
+  intr_set_level (old_level);
+  if (page_idx == SIZE_MAX)
+    return false;
+
+  /* Zero the page with interrupts on, so as not to hold them
+     off for that long. */
+  page = mem_base + PGSIZE * page_idx;
+  memset (page, 0, PGSIZE);
+
+  old_level = intr_disable ();
+  if (pool->zeroed_cnt < ZEROED_MAX)
+    {
+      pool->zeroed[pool->zeroed_cnt++] = page;
+      pool->refill_cnt++;
+    }
+  else
+    free_range (pool, page_idx, 1);
+  intr_set_level (old_level);
+  return true;
 }
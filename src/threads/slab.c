@@ -0,0 +1,287 @@
+#include "threads/slab.h"
+#include <debug.h>
+#include <round.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "threads/allocprof.h"
+#include "threads/palloc.h"
+#include "threads/vaddr.h"
+
+/* A slab allocator for fixed-size kernel objects.
+
+   malloc() rounds every request up to a power of 2, which
+   wastes close to half of the memory for an object just over a
+   power of 2, such as a `struct inode'.  A slab cache instead
+   carves pages, called "slabs", into objects of exactly one
+   size, rounded up only to the requested alignment.
+
+   Each slab begins with a `struct slab' header, followed by one
+   16-bit index per object that links the slab's free objects
+   together, followed by the objects themselves.  Because the
+   free list lives outside the objects, an object freed to the
+   cache keeps its contents, so an optional constructor need run
+   only once, when its slab is created, as long as users give
+   objects back in their constructed state.
+
+   A cache keeps its slabs on three lists: partial slabs, from
+   which objects are allocated first, full slabs, and empty
+   slabs.  Only EMPTY_MAX empty slabs are kept; beyond that, a
+   slab that becomes empty goes back to the page allocator.
+
+   Any space left over at the end of a slab is used to "colour"
+   it: successive slabs start their objects at successive
+   multiples of the cache's colour step, so that the same object
+   in different slabs does not always map to the same cache
+   lines. */
+
+/* Magic number for detecting slab corruption. */
+#define SLAB_MAGIC 0x51ab51ab
+
+/* Smallest colour step, in bytes: one cache line. */
+#define COLOR_STEP 32
+
+/* Empty slabs kept per cache. */
+#define EMPTY_MAX 1
+
+/* A slab: one page of objects. */
+struct slab
+  {
+    unsigned magic;             /* Always set to SLAB_MAGIC. */
+    struct slab_cache *cache;   /* Owning cache. */
+    struct list_elem elem;      /* Element in one of the cache's lists. */
+    uint8_t *objs;              /* First object. */
+    size_t in_use;              /* Number of objects in use. */
+    size_t free_head;           /* First free object, or OBJS_PER_SLAB. */
+    uint16_t next_free[];       /* Free object following each object. */
+  };
+
+/* All slab caches, for statistics.  Caches are created during
+   initialization only, so this list needs no lock. */
+static struct list all_caches = LIST_INITIALIZER (all_caches);
+
+static struct slab *slab_create (struct slab_cache *);
+static struct slab *obj_to_slab (struct slab_cache *, void *);
+
+/* Initializes cache C for objects of OBJ_SIZE bytes aligned on
+   ALIGN bytes, which must be a power of 2, naming it NAME for
+   statistics.  If CTOR is nonnull, it is called on each object
+   once, when the object's slab is created. */
+void
+slab_cache_init (struct slab_cache *c, const char *name,
+                 size_t obj_size, size_t align, slab_ctor_func *ctor)
+{
+  size_t hdr_size, n;
+
+  ASSERT (c != NULL);
+  ASSERT (obj_size > 0);
+  ASSERT (align != 0 && (align & (align - 1)) == 0);
+
+  if (align < sizeof (void *))
+    align = sizeof (void *);
+  obj_size = ROUND_UP (obj_size, align);
+
+  /* Fit as many objects and free list entries as possible into
+     a page after the header. */
+  n = (PGSIZE - sizeof (struct slab)) / (obj_size + sizeof (uint16_t));
+  for (;;)
+    {
+      ASSERT (n > 0);
+      hdr_size = ROUND_UP (sizeof (struct slab) + n * sizeof (uint16_t),
+                           align);
+      if (hdr_size + n * obj_size <= PGSIZE)
+        break;
+      n--;
+    }
+
+  c->name = name;
+  c->obj_size = obj_size;
+  c->align = align;
+  c->ctor = ctor;
+  c->objs_per_slab = n;
+  c->obj_ofs = hdr_size;
+  c->color_step = align > COLOR_STEP ? align : COLOR_STEP;
+  c->color_cnt = (PGSIZE - hdr_size - n * obj_size) / c->color_step + 1;
+  c->next_color = 0;
+
+  lock_init (&c->lock);
+  list_init (&c->partial);
+  list_init (&c->full);
+  list_init (&c->empty);
+  c->empty_cnt = 0;
+  c->slab_cnt = 0;
+  c->obj_cnt = 0;
+
+  list_push_back (&all_caches, &c->elem);
+}
+
+/* Obtains and returns an object from cache C.
+   Returns a null pointer if memory is not available. */
+void *
+slab_alloc (struct slab_cache *c)
+{
+  struct slab *s;
+  size_t idx;
+  void *obj;
+
+  lock_acquire (&c->lock);
+
+  /* Prefer a partial slab, then an empty one, then a new one. */
+  if (!list_empty (&c->partial))
+    s = list_entry (list_front (&c->partial), struct slab, elem);
+  else
+    {
+      if (!list_empty (&c->empty))
+        {
+          s = list_entry (list_pop_front (&c->empty), struct slab, elem);
+          c->empty_cnt--;
+        }
+      else
+        {
+          s = slab_create (c);
+          if (s == NULL)
+            {
+              lock_release (&c->lock);
+              return NULL;
+            }
+        }
+      list_push_front (&c->partial, &s->elem);
+    }
+
+  /* Take its first free object. */
+  idx = s->free_head;
+  ASSERT (idx < c->objs_per_slab);
+  s->free_head = s->next_free[idx];
+  c->obj_cnt++;
+  if (++s->in_use == c->objs_per_slab)
+    {
+      list_remove (&s->elem);
+      list_push_front (&c->full, &s->elem);
+    }
+  obj = s->objs + idx * c->obj_size;
+
+  lock_release (&c->lock);
+  if (allocprof_enabled)
+    allocprof_alloc (obj, c->obj_size, __builtin_return_address (0));
+  return obj;
+}
+
+/* Frees OBJ, which must have been allocated from cache C. */
+void
+slab_free (struct slab_cache *c, void *obj)
+{
+  struct slab *s;
+  size_t idx;
+
+  if (obj == NULL)
+    return;
+  if (allocprof_enabled)
+    allocprof_free (obj);
+
+  s = obj_to_slab (c, obj);
+  idx = ((uint8_t *) obj - s->objs) / c->obj_size;
+
+#ifndef NDEBUG
+  /* Clear the object to help detect use-after-free bugs, unless
+     it must keep its constructed state. */
+  if (c->ctor == NULL)
+    memset (obj, 0xcc, c->obj_size);
+#endif
+
+  lock_acquire (&c->lock);
+
+  if (s->in_use == c->objs_per_slab)
+    {
+      list_remove (&s->elem);
+      list_push_front (&c->partial, &s->elem);
+    }
+  s->next_free[idx] = s->free_head;
+  s->free_head = idx;
+  c->obj_cnt--;
+
+  if (--s->in_use == 0)
+    {
+      list_remove (&s->elem);
+      if (c->empty_cnt < EMPTY_MAX)
+        {
+          list_push_front (&c->empty, &s->elem);
+          c->empty_cnt++;
+        }
+      else
+        {
+          c->slab_cnt--;
+          palloc_free_page (s);
+        }
+    }
+
+  lock_release (&c->lock);
+}
+
+/* Prints statistics for every slab cache. */
+void
+slab_print_stats (void)
+{
+  struct list_elem *e;
+
+  for (e = list_begin (&all_caches); e != list_end (&all_caches);
+       e = list_next (e))
+    {
+      struct slab_cache *c = list_entry (e, struct slab_cache, elem);
+
+      printf ("Slab: %s: %zu of %zu objects of %zu bytes in use, "
+              "%zu slabs (%zu partial, %zu full, %zu empty)\n",
+              c->name, c->obj_cnt, c->slab_cnt * c->objs_per_slab,
+              c->obj_size, c->slab_cnt, list_size (&c->partial),
+              list_size (&c->full), c->empty_cnt);
+    }
+}
+
+/* Allocates a new slab for cache C, which must be locked, and
+   constructs its objects.  Returns the slab, or a null pointer
+   if memory is not available. */
+static struct slab *
+slab_create (struct slab_cache *c)
+{
+  struct slab *s;
+  size_t i;
+
+  ASSERT (lock_held_by_current_thread (&c->lock));
+
+  s = palloc_get_page (PAL_NOPROF);
+  if (s == NULL)
+    return NULL;
+
+  s->magic = SLAB_MAGIC;
+  s->cache = c;
+  s->objs = ((uint8_t *) s + c->obj_ofs
+             + c->next_color * c->color_step);
+  s->in_use = 0;
+  s->free_head = 0;
+  for (i = 0; i < c->objs_per_slab; i++)
+    {
+      s->next_free[i] = i + 1;
+      if (c->ctor != NULL)
+        c->ctor (s->objs + i * c->obj_size);
+    }
+
+  c->next_color = (c->next_color + 1) % c->color_cnt;
+  c->slab_cnt++;
+  return s;
+}
+
+/* Returns the slab in cache C that OBJ is inside. */
+static struct slab *
+obj_to_slab (struct slab_cache *c, void *obj)
+{
+  struct slab *s = pg_round_down (obj);
+
+  /* Check that the slab is valid. */
+  ASSERT (s->magic == SLAB_MAGIC);
+  ASSERT (s->cache == c);
+
+  /* Check that the object is properly aligned for the slab. */
+  ASSERT ((uint8_t *) obj >= s->objs);
+  ASSERT (((uint8_t *) obj - s->objs) % c->obj_size == 0);
+
+  return s;
+}
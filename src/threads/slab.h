@@ -0,0 +1,42 @@
+#ifndef THREADS_SLAB_H
+#define THREADS_SLAB_H
+
+#include <list.h>
+#include <stddef.h>
+#include "threads/synch.h"
+
+/* Constructor for objects in a slab cache. */
+typedef void slab_ctor_func (void *obj);
+
+/* A cache of objects of one fixed size.
+   See slab.c for details. */
+struct slab_cache
+  {
+    const char *name;           /* Name, for statistics. */
+    size_t obj_size;            /* Object size, rounded up to ALIGN. */
+    size_t align;               /* Object alignment. */
+    slab_ctor_func *ctor;       /* Constructor, or null. */
+    size_t objs_per_slab;       /* Objects in each slab. */
+    size_t obj_ofs;             /* Offset of the first uncoloured object. */
+    size_t color_cnt;           /* Number of distinct colours. */
+    size_t color_step;          /* Bytes between successive colours. */
+    size_t next_color;          /* Colour of the next new slab. */
+
+    struct lock lock;           /* Protects the members below. */
+    struct list partial;        /* Slabs with some objects in use. */
+    struct list full;           /* Slabs with all objects in use. */
+    struct list empty;          /* Slabs with no objects in use. */
+    size_t empty_cnt;           /* Length of EMPTY. */
+    size_t slab_cnt;            /* Total number of slabs. */
+    size_t obj_cnt;             /* Objects in use. */
+
+    struct list_elem elem;      /* Element in list of all caches. */
+  };
+
+void slab_cache_init (struct slab_cache *, const char *name,
+                      size_t obj_size, size_t align, slab_ctor_func *);
+void *slab_alloc (struct slab_cache *);
+void slab_free (struct slab_cache *, void *);
+void slab_print_stats (void);
+
+#endif /* threads/slab.h */
@@ -433,6 +433,15 @@ idle (void *idle_started_ UNUSED)
       intr_disable ();
       thread_block ();
 
+      /* Zero pages ahead of PAL_ZERO requests for as long as
+         nothing else wants to run. */
+      intr_enable ();
+      while (list_empty (&ready_list) && palloc_refill_zeroed ())
+        continue;
+      intr_disable ();
+      if (!list_empty (&ready_list))
+        continue;
+
       /* Re-enable interrupts and wait for the next one.
 
          The `sti' instruction disables interrupts until the
@@ -507,6 +516,16 @@ init_thread (struct thread *t, const char *name, int priority)
 
   // initialize child list
   list_init(&t->child_list);
+
+  // initialize file list, 0 and 1 are reserved for the console
+  list_init(&t->file_list);
+  t->next_fd = 2;
+#endif
+#ifdef VM
+  t->exec_file = NULL;
+  list_init (&t->mmaps);
+  t->next_mapid = 1;
+  t->heap_start = t->heap_brk = NULL;
 #endif
 }
 
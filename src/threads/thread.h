@@ -4,6 +4,9 @@
 #include <debug.h>
 #include <list.h>
 #include <stdint.h>
+#ifdef VM
+#include <hash.h>
+#endif
 
 int pid_upper;
 
@@ -104,6 +107,37 @@ struct thread
 
     char exit_status;	// exit status for wait
     bool wait;		// the parent has already waited for the thread
+
+    struct list file_list;	// open files(file_elem) of the process
+    int next_fd;		// fd to hand out to the next opened file
+#endif
+#ifdef VM
+    /* Owned by userprog/process.c. */
+    struct file *exec_file;             /* Executable, paged in from. */
+
+    /* Owned by vm/page.c. */
+    struct hash pages;                  /* Supplemental page table. */
+    size_t resident_cnt;                /* Pages in frames; see vm/page.c. */
+    size_t peak_resident_cnt;           /* Most RESIDENT_CNT has been. */
+    long long major_fault_cnt;          /* Faults that read a page in. */
+
+    /* Owned by userprog/exception.c. */
+    long long page_fault_cnt;           /* Page faults resolved. */
+
+    /* Owned by vm/wset.c. */
+    size_t wset_cnt;                    /* Working-set size, in pages. */
+    size_t wset_next_cnt;               /* Counted so far this sweep. */
+
+    /* Owned by vm/mmap.c. */
+    struct list mmaps;                  /* Memory-mapped files. */
+    int next_mapid;                     /* Next mapping identifier. */
+
+    /* Owned by vm/heap.c. */
+    uint8_t *heap_start;                /* First byte of the heap. */
+    uint8_t *heap_brk;                  /* End of the heap. */
+
+    /* Owned by userprog/syscall.c. */
+    void *user_esp;                     /* User %esp at system call entry. */
 #endif
     /* Owned by thread.c. */
     unsigned magic;                     /* Detects stack overflow. */
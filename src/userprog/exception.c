@@ -4,12 +4,23 @@
 #include "userprog/gdt.h"
 #include "threads/interrupt.h"
 #include "threads/thread.h"
+#include "userprog/syscall.h"
 
 #include "threads/vaddr.h"
+#ifdef VM
+#include "vm/page.h"
+#endif
 
 /* Number of page faults processed. */
 static long long page_fault_cnt;
 
+#ifdef VM
+/* Page faults resolved, by kind. */
+static long long page_in_cnt;           /* Pages brought in. */
+static long long stack_grow_cnt;        /* Stack pages added. */
+static long long unshare_cnt;           /* Copy-on-write faults. */
+#endif
+
 static void kill (struct intr_frame *);
 static void page_fault (struct intr_frame *);
 
@@ -67,6 +78,11 @@ void
 exception_print_stats (void) 
 {
   printf ("Exception: %lld page faults\n", page_fault_cnt);
+#ifdef VM
+  printf ("Page faults: %lld paged in, %lld stack growth, "
+          "%lld copy-on-write, %lld pages mapped around\n",
+          page_in_cnt, stack_grow_cnt, unshare_cnt, fault_around_cnt);
+#endif
 }
 
 /* Handler for an exception (probably) caused by a user process. */
@@ -149,7 +165,44 @@ page_fault (struct intr_frame *f)
   not_present = (f->error_code & PF_P) == 0;
   write = (f->error_code & PF_W) != 0;
   user = (f->error_code & PF_U) != 0;
-  
+
+#ifdef VM
+  /* Bring in a page that is part of the process's address space
+     but not resident, or grow the stack down to FAULT_ADDR.  This
+     also covers the kernel touching user memory on behalf of a
+     system call, in which case the user's stack pointer is the
+     one saved on entry to the system call. */
+  if (not_present && is_user_vaddr (fault_addr))
+    {
+      if (page_in (fault_addr, write))
+        {
+          thread_current ()->page_fault_cnt++;
+          page_in_cnt++;
+          return;
+        }
+      if (page_grow_stack (fault_addr,
+                           user ? f->esp : thread_current ()->user_esp))
+        {
+          thread_current ()->page_fault_cnt++;
+          stack_grow_cnt++;
+          return;
+        }
+    }
+
+  /* Give the process its own copy of a page it shares
+     copy-on-write with its parent or children, or with pages
+     merged with it. */
+  if (!not_present && write && is_user_vaddr (fault_addr)
+      && page_unshare (fault_addr))
+    {
+      thread_current ()->page_fault_cnt++;
+      unshare_cnt++;
+      return;
+    }
+
+  /* Anything else is an invalid access by the process. */
+  exit (-1);
+#endif
 
   if(!user || is_kernel_vaddr(fault_addr))
     exit(-1);
@@ -1,12 +1,45 @@
 #include "userprog/pagedir.h"
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdio.h>
 #include <string.h>
 #include "threads/init.h"
+#include "threads/interrupt.h"
 #include "threads/pte.h"
 #include "threads/palloc.h"
 
+/* Above this many pages, pagedir_clear_range() flushes the whole
+   TLB instead of invalidating the pages one by one. */
+#define INVLPG_MAX 32
+
+/* Cache of page directory and page table pages.
+
+   Processes come and go often, and each one needs a page
+   directory and a few page tables, every one a page that palloc
+   would have to find and zero.  Instead, pagedir_destroy() keeps
+   up to CACHE_MAX of each for reuse, clearing each entry as it
+   walks over it to free the pages it maps, so that a page table
+   comes back all zeros and a page directory with only its kernel
+   half filled in.  The entries of a page nobody used cost
+   nothing to clear. */
+#define CACHE_MAX 32
+
+/* Cleared pages kept for reuse. */
+struct table_cache
+  {
+    void *pages[CACHE_MAX];     /* Pages, all cleared. */
+    size_t cnt;                 /* Number of pages in PAGES. */
+    long long hit_cnt;          /* Pages reused. */
+    long long miss_cnt;         /* Pages from palloc. */
+  };
+
+static struct table_cache pd_cache;     /* Page directories. */
+static struct table_cache pt_cache;     /* Page tables. */
+
+static void *cache_get (struct table_cache *);
+static void cache_put (struct table_cache *, void *page);
 static uint32_t *active_pd (void);
+static void invalidate_page (uint32_t *, const void *);
 static void invalidate_pagedir (uint32_t *);
 
 /* Creates a new page directory that has mappings for kernel
@@ -16,14 +49,26 @@ static void invalidate_pagedir (uint32_t *);
 uint32_t *
 pagedir_create (void) 
 {
-  uint32_t *pd = palloc_get_page (0);
+  uint32_t *pd = cache_get (&pd_cache);
+  size_t kernel_ofs = pd_no (PHYS_BASE) * sizeof *pd;
+
+  if (pd != NULL)
+    {
+      /* The user half is already clear. */
+      memcpy ((uint8_t *) pd + kernel_ofs,
+              (uint8_t *) init_page_dir + kernel_ofs, PGSIZE - kernel_ofs);
+      return pd;
+    }
+
+  pd = palloc_get_page (0);
   if (pd != NULL)
     memcpy (pd, init_page_dir, PGSIZE);
   return pd;
 }
 
 /* Destroys page directory PD, freeing all the pages it
-   references. */
+   references.  The page directory and its page tables are
+   cleared along the way and kept for reuse if there is room. */
 void
 pagedir_destroy (uint32_t *pd) 
 {
@@ -34,17 +79,33 @@ pagedir_destroy (uint32_t *pd)
 
   ASSERT (pd != init_page_dir);
   for (pde = pd; pde < pd + pd_no (PHYS_BASE); pde++)
-    if (*pde & PTE_P) 
+    if (*pde != 0) 
       {
         uint32_t *pt = pde_get_pt (*pde);
         uint32_t *pte;
         
         for (pte = pt; pte < pt + PGSIZE / sizeof *pte; pte++)
-          if (*pte & PTE_P) 
-            palloc_free_page (pte_get_page (*pte));
-        palloc_free_page (pt);
+          if (*pte != 0)
+            {
+              if (*pte & PTE_P) 
+                palloc_free_page (pte_get_page (*pte));
+              *pte = 0;
+            }
+        cache_put (&pt_cache, pt);
+        *pde = 0;
       }
-  palloc_free_page (pd);
+  cache_put (&pd_cache, pd);
+}
+
+/* Prints statistics on reuse of page directory and page table
+   pages. */
+void
+pagedir_print_stats (void)
+{
+  printf ("Page tables: %lld directories and %lld tables reused, "
+          "%lld and %lld allocated\n",
+          pd_cache.hit_cnt, pt_cache.hit_cnt,
+          pd_cache.miss_cnt, pt_cache.miss_cnt);
 }
 
 /* Returns the address of the page table entry for virtual
@@ -70,7 +131,9 @@ lookup_page (uint32_t *pd, const void *vaddr, bool create)
     {
       if (create)
         {
-          pt = palloc_get_page (PAL_ZERO);
+          pt = cache_get (&pt_cache);
+          if (pt == NULL)
+            pt = palloc_get_page (PAL_ZERO);
           if (pt == NULL) 
             return NULL; 
       
@@ -152,10 +215,53 @@ pagedir_clear_page (uint32_t *pd, void *upage)
   if (pte != NULL && (*pte & PTE_P) != 0)
     {
       *pte &= ~PTE_P;
-      invalidate_pagedir (pd);
+      invalidate_page (pd, upage);
     }
 }
 
+/* Marks the PAGE_CNT user virtual pages starting at UPAGE "not
+   present" in page directory PD, as pagedir_clear_page() would
+   one by one.  The TLB is invalidated page by page if only a few
+   pages were mapped, otherwise it is flushed at once.  Use this
+   to tear down large ranges. */
+void
+pagedir_clear_range (uint32_t *pd, void *upage, size_t page_cnt)
+{
+  uint8_t *va = upage;
+  uint8_t *end;
+  size_t cleared = 0;
+
+  ASSERT (pg_ofs (upage) == 0);
+  ASSERT (is_user_vaddr (upage));
+  ASSERT (page_cnt <= (size_t) ((uint8_t *) PHYS_BASE - va) / PGSIZE);
+
+  end = va + page_cnt * PGSIZE;
+  while (va < end)
+    {
+      uint32_t *pde = pd + pd_no (va);
+      uint32_t *pte;
+
+      if (*pde == 0)
+        {
+          /* No page table: skip everything it would cover. */
+          va = (uint8_t *) ((uintptr_t) va / PTSPAN * PTSPAN) + PTSPAN;
+          continue;
+        }
+
+      pte = &pde_get_pt (*pde)[pt_no (va)];
+      if ((*pte & PTE_P) != 0)
+        {
+          *pte &= ~PTE_P;
+          if (++cleared <= INVLPG_MAX)
+            invalidate_page (pd, va);
+        }
+      va += PGSIZE;
+    }
+
+  if (cleared > INVLPG_MAX)
+    invalidate_pagedir (pd);
+}
+
 /* Returns true if the PTE for virtual page VPAGE in PD is dirty,
    that is, if the page has been modified since the PTE was
    installed.
@@ -180,7 +286,36 @@ pagedir_set_dirty (uint32_t *pd, const void *vpage, bool dirty)
       else 
         {
           *pte &= ~(uint32_t) PTE_D;
-          invalidate_pagedir (pd);
+          invalidate_page (pd, vpage);
+        }
+    }
+}
+
+/* Returns true if the PTE for virtual page VPAGE in PD is
+   present and writable.  Returns false if PD contains no PTE for
+   VPAGE. */
+bool
+pagedir_is_writable (uint32_t *pd, const void *vpage)
+{
+  uint32_t *pte = lookup_page (pd, vpage, false);
+  return pte != NULL && (*pte & (PTE_P | PTE_W)) == (PTE_P | PTE_W);
+}
+
+/* Sets the writable bit to WRITABLE in the PTE for virtual page
+   VPAGE in PD, keeping its other bits, including the accessed
+   and dirty bits. */
+void
+pagedir_set_writable (uint32_t *pd, const void *vpage, bool writable)
+{
+  uint32_t *pte = lookup_page (pd, vpage, false);
+  if (pte != NULL)
+    {
+      if (writable)
+        *pte |= PTE_W;
+      else
+        {
+          *pte &= ~(uint32_t) PTE_W;
+          invalidate_page (pd, vpage);
         }
     }
 }
@@ -209,7 +344,7 @@ pagedir_set_accessed (uint32_t *pd, const void *vpage, bool accessed)
       else 
         {
           *pte &= ~(uint32_t) PTE_A; 
-          invalidate_pagedir (pd);
+          invalidate_page (pd, vpage);
         }
     }
 }
@@ -243,6 +378,17 @@ active_pd (void)
   return ptov (pd);
 }
 
+/* Invalidates the TLB entry for virtual page VPAGE if PD is the
+   active page directory, leaving the rest of the TLB alone.  Use
+   this after changing a single PTE.  See [IA32-v2a] "INVLPG--
+   Invalidate TLB Entry". */
+static void
+invalidate_page (uint32_t *pd, const void *vpage)
+{
+  if (active_pd () == pd)
+    asm volatile ("invlpg (%0)" : : "r" (vpage) : "memory");
+}
+
 /* Seom page table changes can cause the CPU's translation
    lookaside buffer (TLB) to become out-of-sync with the page
    table.  When this happens, we have to "invalidate" the TLB by
@@ -261,3 +407,36 @@ invalidate_pagedir (uint32_t *pd)
       pagedir_activate (pd);
     } 
 }
+
+/* Removes a cleared page from CACHE and returns it, or returns a
+   null pointer if CACHE is empty. */
+static void *
+cache_get (struct table_cache *cache)
+{
+  enum intr_level old_level = intr_disable ();
+  void *page = NULL;
+
+  if (cache->cnt > 0)
+    {
+      page = cache->pages[--cache->cnt];
+      cache->hit_cnt++;
+    }
+  else
+    cache->miss_cnt++;
+  intr_set_level (old_level);
+  return page;
+}
+
+/* Adds cleared PAGE to CACHE, or frees it if CACHE is full. */
+static void
+cache_put (struct table_cache *cache, void *page)
+{
+  enum intr_level old_level = intr_disable ();
+  bool kept = cache->cnt < CACHE_MAX;
+
+  if (kept)
+    cache->pages[cache->cnt++] = page;
+  intr_set_level (old_level);
+  if (!kept)
+    palloc_free_page (page);
+}
@@ -7,16 +7,25 @@
 #include <string.h>
 #include "userprog/gdt.h"
 #include "userprog/pagedir.h"
+#include "userprog/syscall.h"
 #include "userprog/tss.h"
 #include "filesys/directory.h"
 #include "filesys/file.h"
 #include "filesys/filesys.h"
+#include "filesys/inode.h"
 #include "threads/flags.h"
 #include "threads/init.h"
 #include "threads/interrupt.h"
 #include "threads/palloc.h"
+#include "threads/synch.h"
 #include "threads/thread.h"
 #include "threads/vaddr.h"
+#ifdef VM
+#include "vm/frame.h"
+#include "vm/heap.h"
+#include "vm/mmap.h"
+#include "vm/page.h"
+#endif
 
 
 // specify delimiter string
@@ -38,6 +47,9 @@
 #define MAX_FILENAME 128				// MAXimum length of FILENAME
 
 static thread_func start_process NO_RETURN;
+#ifdef VM
+static thread_func start_fork NO_RETURN;
+#endif
 static bool load (const char *cmdline, void (**eip) (void), void **esp);
 
 /* Starts a new thread running a user program loaded from
@@ -65,8 +77,10 @@ process_execute (const char *file_name)
   strlcpy (tmp_file_name, file_name, strlen(file_name) + 1);
 
   // for exec-missing("no-such-file")
+  lock_acquire(&filesys_lock);
   file = filesys_open(strtok_r(tmp_file_name, DELIMITERS, &save_ptr));
   file_close(file);
+  lock_release(&filesys_lock);
   if(file == NULL)
     return -1; 
 
@@ -113,6 +127,90 @@ start_process (void *file_name_)
   NOT_REACHED ();
 }
 
+#ifdef VM
+/* Handed by process_fork() to the child's start_fork(). */
+struct fork_info
+  {
+    struct intr_frame if_;              /* Parent's user context. */
+    struct thread *parent;              /* Forking process. */
+    struct semaphore done;              /* Upped when the child is set up. */
+    bool success;                       /* Was the child set up? */
+  };
+
+/* Starts a new process that is a copy of the running one, and
+   resumes it from the user context saved in PARENT_IF, returning
+   0 from the system call.  The child shares the parent's pages
+   copy-on-write, and has its own copies of the parent's open
+   files.  Memory mappings are not inherited.  Returns the child's
+   thread id, or TID_ERROR if it cannot be created. */
+tid_t
+process_fork (const struct intr_frame *parent_if)
+{
+  struct thread *cur = thread_current ();
+  struct fork_info info;
+  tid_t tid;
+
+  info.if_ = *parent_if;
+  info.parent = cur;
+  sema_init (&info.done, 0);
+  info.success = false;
+
+  tid = thread_create (cur->name, PRI_DEFAULT, start_fork, &info);
+  if (tid == TID_ERROR)
+    return TID_ERROR;
+  sema_down (&info.done);
+  return info.success ? tid : TID_ERROR;
+}
+
+/* A thread function that copies the address space and files of
+   the parent described by INFO_ and starts the copy running. */
+static void
+start_fork (void *info_)
+{
+  struct fork_info *info = info_;
+  struct thread *parent = info->parent;
+  struct thread *cur = thread_current ();
+  struct intr_frame if_ = info->if_;
+  bool success = false;
+
+  /* The parent waits in process_fork() until we are done, so its
+     address space stays put while we copy it. */
+  if (page_table_init (&cur->pages))
+    {
+      cur->pagedir = pagedir_create ();
+      if (cur->pagedir == NULL)
+        page_table_destroy (&cur->pages);
+    }
+  if (cur->pagedir != NULL)
+    {
+      process_activate ();
+      lock_acquire (&filesys_lock);
+      cur->exec_file = file_reopen (parent->exec_file);
+      if (cur->exec_file != NULL)
+        {
+          file_deny_write (cur->exec_file);
+          success = copy_files (parent);
+        }
+      lock_release (&filesys_lock);
+      success = success && page_table_fork (parent);
+      if (success)
+        heap_fork (parent);
+    }
+
+  /* INFO is on the parent's stack, so it is gone once the parent
+     has been woken up. */
+  info->success = success;
+  sema_up (&info->done);
+  if (!success)
+    thread_exit ();
+
+  /* Return 0 from fork() in the child. */
+  if_.eax = 0;
+  asm volatile ("movl %0, %%esp; jmp intr_exit" : : "g" (&if_) : "memory");
+  NOT_REACHED ();
+}
+#endif
+
 /* Waits for thread TID to die and returns its exit status.  If
    it was terminated by the kernel (i.e. killed due to an
    exception), returns -1.  If TID is invalid or if it was not a
@@ -166,11 +264,27 @@ process_exit (void)
   struct thread *cur = thread_current ();
   uint32_t *pd;
 
+  close_all_files ();
+
   /* Destroy the current process's page directory and switch back
      to the kernel-only page directory. */
   pd = cur->pagedir;
   if (pd != NULL) 
     {
+#ifdef VM
+      /* Write back mapped files and release frames and swap
+         slots while the page directory they are mapped in still
+         exists.  Unmapping all of user space first costs a single
+         TLB flush, instead of one invalidation per page. */
+      pagedir_clear_range (pd, NULL, (uintptr_t) PHYS_BASE / PGSIZE);
+      mmap_unmap_all ();
+      page_table_destroy (&cur->pages);
+      lock_acquire (&filesys_lock);
+      file_close (cur->exec_file);
+      lock_release (&filesys_lock);
+      cur->exec_file = NULL;
+#endif
+
       /* Correct ordering here is crucial.  We must set
          cur->pagedir to NULL before switching page directories,
          so that a timer interrupt can't switch back to the
@@ -340,6 +454,9 @@ load (const char *file_name, void (**eip) (void), void **esp)
   off_t file_ofset;
   bool success = false;
   int i;
+#ifdef VM
+  uintptr_t load_end = 0;       /* End of the highest segment. */
+#endif
 
   // arguments for function file_name_to_argv 
   char *argv[MAX_ARG];	// arguments
@@ -352,10 +469,23 @@ load (const char *file_name, void (**eip) (void), void **esp)
   int esp_offset_addr;	// bytes occupied by address of arguments
   uint8_t *tmp_esp;	// temporary esp
 
-  /* Allocate and activate page directory. */
+  lock_acquire (&filesys_lock);
+
+  /* Allocate and activate page directory.  process_exit()
+     destroys the supplemental page table only if there is a page
+     directory, so set it up first. */
+#ifdef VM
+  if (!page_table_init (&t->pages))
+    goto done;
+#endif
   t->pagedir = pagedir_create ();
   if (t->pagedir == NULL) 
-    goto done;
+    {
+#ifdef VM
+      page_table_destroy (&t->pages);
+#endif
+      goto done;
+    }
   process_activate ();
 
   strlcpy(tmp_file_name, file_name, strlen(file_name) + 1);	// strcp to avoid error
@@ -370,6 +500,15 @@ if (file == NULL)
       printf ("load: %s: open failed\n", file_name);
       goto done; 
     }
+#ifdef VM
+  /* Its code would be mapped from pages that a mapping can
+     write. */
+  if (inode_mapped_writable (file_get_inode (file)))
+    {
+      printf ("load: %s: file is mapped for writing\n", file_name);
+      goto done; 
+    }
+#endif
 
   /* Read and verify executable header. */
   if (file_read (file, &ehdr, sizeof ehdr) != sizeof ehdr
@@ -437,6 +576,10 @@ if (file == NULL)
               if (!load_segment (file, file_page, (void *) mem_page,
                                  read_bytes, zero_bytes, writable))
                 goto done;
+#ifdef VM
+              if (phdr.p_vaddr + phdr.p_memsz > load_end)
+                load_end = phdr.p_vaddr + phdr.p_memsz;
+#endif
             }
           else
             goto done;
@@ -482,7 +625,21 @@ if (file == NULL)
 
   success = true;
  done:
+#ifdef VM
+  /* Segments are paged in from the executable on demand, so keep
+     it open, and unchanged, for as long as the process runs. */
+  if (success)
+    {
+      file_deny_write (file);
+      t->exec_file = file;
+      heap_init ((void *) load_end);
+    }
+  else
+    file_close (file);
+#else
   file_close (file);
+#endif
+  lock_release (&filesys_lock);
   if(success == false)
     exit(-1);
   return success;
@@ -490,7 +647,9 @@ if (file == NULL)
 
 /* load() helpers. */
 
+#ifndef VM
 static bool install_page (void *upage, void *kpage, bool writable);
+#endif
 
 /* Checks whether PHDR describes a valid, loadable segment in
    FILE and returns true if so, false otherwise. */
@@ -569,6 +728,20 @@ load_segment (struct file *file, off_t ofs, uint8_t *upage,
       size_t page_read_bytes = read_bytes < PGSIZE ? read_bytes : PGSIZE;
       size_t page_zero_bytes = PGSIZE - page_read_bytes;
 
+#ifdef VM
+      /* Record where the page comes from; it is read in on the
+         first fault.  FILE stays open until the process exits. */
+      struct page *p = page_create (upage, writable);
+      if (p == NULL)
+        return false;
+      if (page_read_bytes > 0)
+        {
+          p->file = file;
+          p->file_ofs = ofs;
+          p->read_bytes = page_read_bytes;
+        }
+      ofs += page_read_bytes;
+#else
       /* Get a page of memory. */
       uint8_t *knpage = palloc_get_page (PAL_USER);
       if (knpage == NULL)
@@ -588,6 +761,7 @@ load_segment (struct file *file, off_t ofs, uint8_t *upage,
           palloc_free_page (knpage);
           return false; 
         }
+#endif
 
       /* Advance. */
       read_bytes -= page_read_bytes;
@@ -602,6 +776,14 @@ load_segment (struct file *file, off_t ofs, uint8_t *upage,
 static bool
 setup_stack (void **esp) 
 {
+#ifdef VM
+  uint8_t *upage = ((uint8_t *) PHYS_BASE) - PGSIZE;
+
+  if (page_create (upage, true) == NULL || !page_in (upage, true))
+    return false;
+  *esp = PHYS_BASE;
+  return true;
+#else
   uint8_t *kpage;
   bool success = false;
 
@@ -615,8 +797,10 @@ setup_stack (void **esp)
         palloc_free_page (kpage);
     }
   return success;
+#endif
 }
 
+#ifndef VM
 /* Adds a mapping from user virtual address UPAGE to kernel
    virtual address KPAGE to the page table.
    If WRITABLE is true, the user process may modify the page;
@@ -636,3 +820,4 @@ install_page (void *upage, void *kpage, bool writable)
   return (pagedir_get_page (th->pagedir, upage) == NULL
           && pagedir_set_page (th->pagedir, upage, kpage, writable));
 }
+#endif
@@ -1,29 +1,49 @@
 #include "userprog/syscall.h"
 #include <stdio.h>
+#include <string.h>
 #include <syscall-nr.h>
 #include "threads/interrupt.h"
 #include "threads/thread.h"
 
 // 추가한 헤더 파일
+#include "devices/input.h"
 #include "devices/shutdown.h"
+#include "filesys/file.h"
+#include "filesys/filesys.h"
 #include "userprog/pagedir.h"
+#include "userprog/process.h"
+#include "threads/palloc.h"
+#include "threads/slab.h"
 #include "threads/vaddr.h"
+#ifdef VM
+#include "vm/heap.h"
+#include "vm/mmap.h"
+#include "vm/page.h"
+#endif
 
 static void syscall_handler (struct intr_frame *);
 
+typedef uint32_t (*func_of_0arg) (void);
 typedef uint32_t (*func_of_1arg) (uint32_t arg1);
 typedef uint32_t (*func_of_2arg) (uint32_t arg1, uint32_t arg2);
 typedef uint32_t (*func_of_3arg) (uint32_t arg1, uint32_t arg2, uint32_t arg3);
 typedef uint32_t (*func_of_4arg) (uint32_t arg1, uint32_t arg2, uint32_t arg3, uint32_t arg4);
 
-struct list file_list;
-
+// element of thread's file_list
 typedef struct{
   int fd;
   struct file *file;
   struct list_elem elem;
 }file_elem;
 
+// cache the file_elems are allocated from
+static struct slab_cache file_elem_cache;
+
+#ifdef VM
+// print memory statistics along with the exit status
+bool exit_memstat;
+#endif
+
 
 // array of function addresses indexed unsing syscall enumeratior
 func_of_4arg syscall_arr[SYS_INUMBER + 1] =	// SYS_INMUBER is the last element in the enum
@@ -45,14 +65,16 @@ func_of_4arg syscall_arr[SYS_INUMBER + 1] =	// SYS_INMUBER is the last element i
 
   // Additional Implementation
   (func_of_4arg)pibonacci,
-  (func_of_4arg)sum_of_four_integers//,
-  
+  (func_of_4arg)sum_of_four_integers,
 
   // project 3
-  /*
-  (func_of_3arg)mmap,
-  (func_of_3arg)munmap,
-  */
+#ifdef VM
+  (func_of_4arg)mmap,
+  (func_of_4arg)munmap,
+  (func_of_4arg)fork,
+  (func_of_4arg)sbrk,
+  (func_of_4arg)memstat,
+#endif
   // project 4
   /*
   (func_of_3arg)chdir,
@@ -81,15 +103,23 @@ char syscall_argc[SYS_INUMBER + 1] =
   1, // close
 
   1, // pibonacci
-  4  // sum of four integers
+  4, // sum of four integers
+
+#ifdef VM
+  2, // mmap
+  1, // munmap
+  0, // fork
+  1, // sbrk
+  1, // memstat
+#endif
 };
 
 void
 syscall_init (void) 
 {
   intr_register_int (0x30, 3, INTR_ON, syscall_handler, "syscall");
-
-  list_init(&file_list);
+  slab_cache_init (&file_elem_cache, "file_elem", sizeof (file_elem),
+                   __alignof__ (file_elem), NULL);
 }
 
 // the name of stack pointer variable
@@ -107,16 +137,25 @@ syscall_handler (struct intr_frame *f UNUSED)
   uint32_t *esp = f->esp;
   uint32_t *eax = &(f->eax);
 
+#ifdef VM
+  // for stack growth on faults taken while serving the call
+  thread_current()->user_esp = esp;
+#endif
+
   // check the validity of stack pointer to syscall number
   if(!valid(esp))
     exit(-1);
 
   int syscall_enum = *esp;    
 
+  // unknown or unimplemented system call
+  if(syscall_enum < 0 || syscall_enum > SYS_INUMBER || syscall_arr[syscall_enum] == NULL)
+    exit(-1);
+
   switch(syscall_argc[syscall_enum]){
   // 0 arguments
   case 0:
-    halt();
+    *eax = ((func_of_0arg)syscall_arr[syscall_enum])();
     break;
 
   // 1 argument
@@ -159,24 +198,98 @@ syscall_handler (struct intr_frame *f UNUSED)
 bool valid(void *vaddr){
   struct thread *t = thread_current();
 
-  if(vaddr != NULL && is_user_vaddr(vaddr) && pagedir_get_page(t->pagedir, vaddr) != NULL)
-    return true;  
+  if(vaddr == NULL || !is_user_vaddr(vaddr))
+    return false;
+  if(pagedir_get_page(t->pagedir, vaddr) != NULL)
+    return true;
+#ifdef VM
+  // evicted pages are still valid; they are paged back in on access
+  if(page_lookup(t, vaddr) != NULL)
+    return true;
+  // so are addresses the stack grows down to on access
+  if(page_is_stack_access(vaddr, t->user_esp))
+    return true;
+#endif
   return false;
 }
 
+// check every page of the SIZE bytes at BUFFER
+bool valid_range(const void *buffer, unsigned size){
+  const uint8_t *p = pg_round_down(buffer);
+  const uint8_t *end = (const uint8_t *)buffer + size;
+
+  if(size == 0)
+    return true;
+  if(end < (const uint8_t *)buffer)
+    return false;
+
+  for(; p < end; p += PGSIZE)
+    if(!valid((void *)(p < (const uint8_t *)buffer ? buffer : p)))
+      return false;
+  return true;
+}
+
 void error(void){
    exit(-1);
 }
 
-struct file *fd_to_file(struct list list, int fd){
+// find the file_elem for FD in current thread's file list
+static file_elem *fd_to_elem(int fd){
+  struct list *list = &thread_current()->file_list;
   struct list_elem *e;
   file_elem *f;
 
-  for (e = list_begin (&list); e != list_end(&list); e = list_next(e)){
+  for (e = list_begin (list); e != list_end(list); e = list_next(e)){
     f = list_entry(e, file_elem, elem);
     if(f->fd == fd)
-      return f->file;
+      return f;
+  }
+  return NULL;
+}
+
+// find the file opened as FD by current thread, NULL if none
+struct file *fd_to_file(int fd){
+  file_elem *f = fd_to_elem(fd);
+
+  return f != NULL ? f->file : NULL;
+}
+
+// close every file still opened by current thread
+void close_all_files(void){
+  struct list *list = &thread_current()->file_list;
+
+  lock_acquire(&filesys_lock);
+  while(!list_empty(list)){
+    file_elem *f = list_entry(list_pop_front(list), file_elem, elem);
+    file_close(f->file);
+    slab_free(&file_elem_cache, f);
   }
+  lock_release(&filesys_lock);
+}
+
+// give current thread its own copy of every file PARENT has open,
+// under the same fds and at the same positions
+bool copy_files(struct thread *parent){
+  struct thread *cur = thread_current();
+  struct list_elem *e;
+
+  for (e = list_begin(&parent->file_list); e != list_end(&parent->file_list); e = list_next(e)){
+    file_elem *pf = list_entry(e, file_elem, elem);
+    file_elem *f = slab_alloc(&file_elem_cache);
+    if(f == NULL)
+      return false;
+
+    f->file = file_reopen(pf->file);
+    if(f->file == NULL){
+      slab_free(&file_elem_cache, f);
+      return false;
+    }
+    file_seek(f->file, file_tell(pf->file));
+    f->fd = pf->fd;
+    list_push_back(&cur->file_list, &f->elem);
+  }
+  cur->next_fd = parent->next_fd;
+  return true;
 }
 
 /* Terminates Pintos by calling shutdown_Power_off(). */
@@ -188,10 +301,31 @@ void halt (void){
 void exit (int status){
   struct thread *cur = thread_current();
   printf ("%s: exit(%d)\n", cur->name, status);
+#ifdef VM
+  if(exit_memstat){
+    struct memstat ms;
+
+    page_memstat(&ms);
+    printf ("%s: %zu pages resident (peak %zu), %zu shared, %zu swapped, "
+            "%zu in working set, %lld minor faults, %lld major faults\n",
+            cur->name, ms.resident_pages, ms.peak_resident_pages,
+            ms.shared_pages, ms.swapped_pages, ms.working_set_pages,
+            ms.minor_faults, ms.major_faults);
+  }
+#endif
   dying_thread.exit_status = status;
   thread_exit();
 }
 
+#ifdef VM
+pid_t fork (void){
+  // the user context saved on entry sits at the top of the kernel stack
+  struct intr_frame *f = (struct intr_frame *)((uint8_t *)thread_current() + PGSIZE) - 1;
+
+  return process_fork(f);
+}
+#endif
+
 pid_t exec (const char *cmd_line){
   pid_t pid;
   struct thread *child;
@@ -212,26 +346,107 @@ int wait (pid_t pid){
 }
 
 bool create (const char *file, unsigned initial_size){
-  return 0;
+  bool success;
+
+  if(!valid((void *)file))
+    exit(-1);
+
+  lock_acquire(&filesys_lock);
+  success = filesys_create(file, initial_size);
+  lock_release(&filesys_lock);
+  return success;
 }
 
 bool remove (const char *file){
-  return 0;
+  bool success;
+
+  if(!valid((void *)file))
+    exit(-1);
+
+  lock_acquire(&filesys_lock);
+  success = filesys_remove(file);
+  lock_release(&filesys_lock);
+  return success;
 }
 
 int open (const char *file){
-  return 0;
+  struct thread *cur = thread_current();
+  file_elem *f;
+
+  if(!valid((void *)file))
+    exit(-1);
+
+  f = slab_alloc(&file_elem_cache);
+  if(f == NULL)
+    return -1;
+
+  lock_acquire(&filesys_lock);
+  f->file = filesys_open(file);
+  lock_release(&filesys_lock);
+  if(f->file == NULL){
+    slab_free(&file_elem_cache, f);
+    return -1;
+  }
+
+  f->fd = cur->next_fd++;
+  list_push_back(&cur->file_list, &f->elem);
+  return f->fd;
 }
 
 int filesize (int fd){
-  return 0;
+  struct file *file = fd_to_file(fd);
+  int length;
+
+  if(file == NULL)
+    return -1;
+  lock_acquire(&filesys_lock);
+  length = file_length(file);
+  lock_release(&filesys_lock);
+  return length;
+}
+
+// read or write SIZE bytes between FILE and user memory at BUFFER,
+// a page at a time through a kernel buffer.  the file system must
+// not touch user memory itself: a page fault there could need to
+// write back a page of the very file whose lock it holds
+static int file_xfer(struct file *file, void *buffer, unsigned size, bool write){
+  uint8_t *ubuf = buffer;
+  uint8_t *kbuf;
+  int done = 0;
+
+  kbuf = palloc_get_page(0);
+  if(kbuf == NULL)
+    return -1;
+
+  while(size > 0){
+    int chunk = size < PGSIZE ? (int)size : PGSIZE;
+    int n;
+
+    if(write)
+      memcpy(kbuf, ubuf + done, chunk);
+    lock_acquire(&filesys_lock);
+    n = write ? file_write(file, kbuf, chunk) : file_read(file, kbuf, chunk);
+    lock_release(&filesys_lock);
+    if(!write)
+      memcpy(ubuf + done, kbuf, n);
+
+    done += n;
+    size -= n;
+    if(n < chunk)
+      break;
+  }
+  palloc_free_page(kbuf);
+  return done;
 }
 
 int read (int fd, void *buffer, unsigned size){
   unsigned i;
   char c;
   uint8_t *cast_buffer = (uint8_t *)buffer;
+  struct file *file;
 
+  if(!valid_range(buffer, size))
+    exit(-1);
 
   switch(fd){
   case STDIN_FILENO:
@@ -241,12 +456,18 @@ int read (int fd, void *buffer, unsigned size){
   case STDOUT_FILENO:
     return 0;
   default:
-    return 0;
+    file = fd_to_file(fd);
+    return file != NULL ? file_xfer(file, buffer, size, false) : -1;
   }
   return 0;
 }
 
 int write (int fd, const void *buffer, unsigned size){
+  struct file *file;
+
+  if(!valid_range(buffer, size))
+    exit(-1);
+
   switch(fd){
   case STDIN_FILENO:
     return 0;
@@ -254,23 +475,81 @@ int write (int fd, const void *buffer, unsigned size){
     putbuf(buffer, size);
     return size;	
   default:
-    return 0;
+    file = fd_to_file(fd);
+    return file != NULL ? file_xfer(file, (void *)buffer, size, true) : -1;
   } 
 
   return 0;
 }
 
 void seek (int fd, unsigned position){
-  ;
+  struct file *file = fd_to_file(fd);
+
+  if(file == NULL)
+    return;
+  lock_acquire(&filesys_lock);
+  file_seek(file, position);
+  lock_release(&filesys_lock);
 }
 
 unsigned tell (int fd){
-  return 0;
+  struct file *file = fd_to_file(fd);
+  unsigned position;
+
+  if(file == NULL)
+    return 0;
+  lock_acquire(&filesys_lock);
+  position = file_tell(file);
+  lock_release(&filesys_lock);
+  return position;
 }
 
 void close (int fd){
-  ;
+  file_elem *f = fd_to_elem(fd);
+
+  if(f == NULL)
+    return;
+  list_remove(&f->elem);
+  lock_acquire(&filesys_lock);
+  file_close(f->file);
+  lock_release(&filesys_lock);
+  slab_free(&file_elem_cache, f);
+}
+
+#ifdef VM
+/* Maps the file open as FD into memory at ADDR. */
+mapid_t mmap (int fd, void *addr){
+  struct file *file = fd_to_file(fd);
+
+  if(file == NULL)
+    return MAP_FAILED;
+
+  return mmap_map(file, addr);
+}
+
+/* Removes mapping MAPPING, writing back its dirty pages. */
+void munmap (mapid_t mapping){
+  mmap_unmap(mapping);
+}
+
+/* Moves the end of the heap by INCREMENT bytes, returning the old end. */
+void *sbrk (intptr_t increment){
+  return heap_sbrk(increment);
+}
+
+/* Writes the process's memory usage and page fault counts to MS. */
+bool memstat (struct memstat *ms){
+  struct memstat copy;
+
+  if(!valid_range(ms, sizeof *ms))
+    exit(-1);
+
+  // fill in a copy first, so faults on MS do not skew the counts
+  page_memstat(&copy);
+  *ms = copy;
+  return true;
 }
+#endif
 
 int pibonacci (int n){
   int f[n + 1];
@@ -5,11 +5,16 @@
 #include <stdbool.h>
 #include <list.h>
 
+struct thread;
+
 void syscall_init (void);
 
 /*mod_func********************************************************/
 bool valid(void *vaddr);
-struct file *fd_to_file(struct list list, int fd);
+bool valid_range(const void *buffer, unsigned size);
+struct file *fd_to_file(int fd);
+void close_all_files(void);
+bool copy_files(struct thread *parent);
 
 void halt (void);
 void exit (int status);
@@ -24,6 +29,16 @@ int write (int fd, const void *buffer, unsigned size);
 void seek (int fd, unsigned position);
 unsigned tell (int fd);
 void close (int fd);
+#ifdef VM
+mapid_t mmap (int fd, void *addr);
+void munmap (mapid_t mapping);
+pid_t fork (void);
+void *sbrk (intptr_t increment);
+bool memstat (struct memstat *ms);
+
+/* Print memory statistics in the exit message?  Set with -ms. */
+extern bool exit_memstat;
+#endif
 
 int pibonacci (int n);
 int sum_of_four_integers(int a, int b, int c, int d);
@@ -0,0 +1,1416 @@
+#include "vm/frame.h"
+#include <debug.h>
+#include <radix.h>
+#include <round.h>
+#include <stdio.h>
+#include <string.h>
+#include "filesys/file.h"
+#include "filesys/inode.h"
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "userprog/pagedir.h"
+#include "vm/page.h"
+#include "vm/swap.h"
+#include "vm/wset.h"
+
+/* Frame table.
+
+   Every page obtained from the user pool for a user page is
+   described by a `struct frame' on FRAME_LIST.  When the user
+   pool runs dry, frame_alloc() takes a frame away from its
+   current page with a second-chance ("clock") sweep over the
+   list: a frame whose page has been accessed since the hand last
+   passed it gets its accessed bit cleared and is skipped, and
+   the first frame found unaccessed is evicted through
+   page_evict().  The sweep then carries on a little further to
+   gather other unaccessed frames of the same process, which are
+   evicted along with the victim so that swap can write them to
+   contiguous slots in one go.  Their frames go back to the user
+   pool, ready for the allocations that follow.
+
+   File data lives in the page cache: cache frames, each holding
+   one page of a file, found through a radix tree in the file's
+   inode keyed by page number.  inode_read_at() copies out of
+   them through frame_cache_get(), and inode_write_at() updates
+   them through frame_cache_update() as it writes to disk.  Pages
+   of memory-mapped files, and read-only pages of executables that
+   match a page of the file (see page_load()), map them directly
+   through frame_share(), so every process that maps a page of a
+   file shares one frame with the others and with read().  A
+   cache frame stays cached when nothing maps it, and is evicted
+   like any other frame once the clock finds it unaccessed: it is
+   unmapped from every page, written back if a mapping of a
+   memory-mapped file dirtied it, and dropped from the cache.
+
+   After a fork, parent and child map each anonymous frame of the
+   parent read-only, a "copy-on-write" frame.  The first process
+   to write to it gets a copy of its own through frame_unshare().
+   All pages mapping a copy-on-write frame refer to the same swap
+   slot, or to none, so evicting it writes it at most once and
+   leaves every page referring to that slot.
+
+   ZERO_FRAME holds a page of zeros.  An anonymous page that has
+   never been written is mapped to it read-only by frame_zero(),
+   and gets a frame of its own through frame_unshare() when it is
+   first written.  The zero frame is not on FRAME_LIST and is
+   never evicted or freed.
+
+   So that faults seldom have to evict anything themselves, a
+   kernel thread reclaims frames in the background.  frame_get()
+   wakes it when fewer than RECLAIM_LOW pages are left for user
+   frames, and it runs the same clock sweep, returning the frames
+   it evicts to the user pool, until RECLAIM_HIGH pages are
+   available again.  Along the way it cleans up to
+   RECLAIM_CLEAN_MAX of the private pages that the sweep passes
+   over because they were accessed lately, picking those outside
+   their process's working set, which are the likeliest to be
+   evicted on the next pass: a dirty one is written to swap and
+   marked clean, so that evicting it later costs no I/O.
+
+   Both sweeps also pass over frames in their process's working
+   set, as estimated by vm/wset.c, as long as they find anything
+   else: pick_victim() falls back to the first such frame it saw
+   unaccessed, and the reclaim thread leaves them alone.  The
+   working-set sampler walks the frame list with its own hand,
+   SAMPLE_HAND, a batch at a time.
+
+   Identical anonymous frames are merged into one copy-on-write
+   frame by the same-page merging scanner (see vm/merge.c), which
+   walks the frame list with MERGE_HAND.  A frame whose contents
+   hash the same as when it was last scanned is looked up by that
+   hash in MERGE_TABLE, and merged into the frame found there if
+   memcmp() confirms they match; otherwise it takes that frame's
+   place in the table.  A frame of all zeros is merged into the
+   zero frame instead.  Frames that change are caught by the
+   comparison, so the table needs no cleaning beyond dropping
+   frames as they are freed or reused.  A private frame's page is
+   write-protected from the comparison until it is remapped to
+   the merged frame, so that a write in between, by the process
+   or by the kernel on its behalf (CR0.WP is set), faults and
+   waits for the merge instead of being lost.
+
+   FRAME_LOCK serializes allocation, eviction and release.  The
+   reclaim thread releases it after each frame it frees.  A cache
+   frame is pinned while it is read in, with the lock released,
+   and LOADING tells others to wait for it.  Likewise the reclaim
+   thread does its writes, to clean frames and to evict them, with
+   the lock released and the frames pinned, and CLEANING makes
+   anyone about to fault in, remap, fork, release or update their
+   pages wait in wait_frame() or frame_wait() until it is done, so
+   a page is never paged in while it is still being written out.
+   Evictions by faults in frame_get() keep the lock throughout. */
+
+/* Free page watermarks for the reclaim thread. */
+#define RECLAIM_LOW 32                  /* Wake up below this. */
+#define RECLAIM_HIGH 96                 /* Go back to sleep at this. */
+#define RECLAIM_CLEAN_MAX 4             /* Pages cleaned per frame freed. */
+
+static struct list frame_list;          /* All frames in use. */
+static struct list_elem *clock_hand;    /* Next frame to examine. */
+static struct list_elem *sample_hand;   /* Next frame to sample. */
+static size_t sample_left;              /* Frames left in this sweep. */
+static struct list_elem *merge_hand;    /* Next frame to scan for merging. */
+static size_t merge_left;               /* Frames left in this sweep. */
+static struct hash merge_table;         /* Scanned frames by checksum. */
+static struct condition cache_loaded;   /* Signaled when one is loaded. */
+static struct condition frame_cleaned;  /* Signaled when one is written. */
+static struct frame zero_frame;         /* Shared frame of zeros. */
+static struct lock frame_lock;          /* Protects the above. */
+
+static struct semaphore reclaim_wake;   /* Upped to start reclaiming. */
+static bool reclaim_pending;            /* RECLAIM_WAKE upped? */
+
+/* Statistics. */
+static long long cache_load_cnt;        /* Cache frames read in. */
+static long long cache_hit_cnt;         /* Cache frames found resident. */
+static long long cow_share_cnt;         /* Frames shared by fork. */
+static long long cow_copy_cnt;          /* Frames copied on write. */
+static long long zero_map_cnt;          /* Pages mapped to ZERO_FRAME. */
+static long long zero_copy_cnt;         /* Of those, written later. */
+static long long direct_evict_cnt;      /* Frames evicted by faults. */
+static long long reclaim_run_cnt;       /* Reclaim thread wake-ups. */
+static long long reclaim_cnt;           /* Frames it freed. */
+static long long clean_cnt;             /* Pages it cleaned. */
+static long long merge_scan_cnt;        /* Frames scanned for merging. */
+static long long merge_cnt;             /* Frames freed by merging. */
+static long long merge_page_cnt;        /* Pages moved by merging. */
+static long long merge_zero_cnt;        /* Frames merged into ZERO_FRAME. */
+
+static struct frame *frame_get (struct page *, bool may_evict, bool zero);
+static struct frame *clock_advance (void);
+static bool frame_test_and_clear_accessed (struct frame *);
+static bool frame_in_wset (struct frame *);
+static struct frame *pick_victim (void);
+static bool evict_cluster (struct frame *victim, bool unlock);
+static bool evict_shared (struct frame *victim, bool unlock);
+static bool evict_cow (struct frame *victim, bool unlock);
+static void frame_destroy (struct frame *);
+static bool frame_is_private (struct frame *);
+static struct page *frame_page (struct frame *);
+static thread_func reclaim_thread;
+static bool reclaim_frame (void);
+static bool clean_frame (struct frame *);
+static struct frame *wait_frame (struct page *);
+static void io_start (struct frame *);
+static void io_done (struct frame *);
+static bool frame_is_mergeable (struct frame *);
+static void merge_scan_frame (struct frame *);
+static void merge_frames (struct frame *f, struct frame *into);
+static void merge_unlist (struct frame *);
+static struct page *merge_protect (struct frame *);
+static void merge_unprotect (struct page *);
+static hash_hash_func merge_hash;
+static hash_less_func merge_less;
+
+static struct frame *cache_get (struct inode *, size_t page_idx,
+                                bool *loaded);
+static void cache_drop (struct frame *);
+static void cache_write_back (struct frame *);
+static size_t cache_bytes (const struct frame *);
+
+/* Initializes the frame table. */
+void
+frame_init (void)
+{
+  list_init (&frame_list);
+  cond_init (&cache_loaded);
+  cond_init (&frame_cleaned);
+  lock_init (&frame_lock);
+  clock_hand = NULL;
+  sample_hand = NULL;
+  sample_left = 0;
+  merge_hand = NULL;
+  merge_left = 0;
+  if (!hash_init (&merge_table, merge_hash, merge_less, NULL))
+    PANIC ("frame: cannot allocate merge table");
+
+  zero_frame.kpage = palloc_get_page (PAL_USER | PAL_ZERO | PAL_ASSERT);
+  list_init (&zero_frame.pages);
+  zero_frame.pin_cnt = 1;
+  zero_frame.inode = NULL;
+  zero_frame.loading = false;
+  zero_frame.cleaning = false;
+
+  sema_init (&reclaim_wake, 0);
+  reclaim_pending = false;
+}
+
+/* Starts the thread that reclaims frames in the background. */
+void
+frame_start_reclaim (void)
+{
+  thread_create ("reclaim", PRI_DEFAULT, reclaim_thread, NULL);
+}
+
+/* Obtains a frame for page P, evicting another page if the user
+   pool is exhausted.  The frame is returned pinned; the caller
+   fills it and maps it with page_map(), which unpins it.
+   Returns a null pointer if no frame could be obtained. */
+struct frame *
+frame_alloc (struct page *p)
+{
+  struct frame *f;
+
+  lock_acquire (&frame_lock);
+  f = frame_get (p, true, false);
+  lock_release (&frame_lock);
+  return f;
+}
+
+/* Like frame_alloc(), but the frame is filled with zeros.  A
+   page from the user pool comes out of its pre-zeroed cache when
+   it can (see threads/palloc.c). */
+struct frame *
+frame_alloc_zeroed (struct page *p)
+{
+  struct frame *f;
+
+  lock_acquire (&frame_lock);
+  f = frame_get (p, true, true);
+  lock_release (&frame_lock);
+  return f;
+}
+
+/* Like frame_alloc(), but returns a null pointer instead of
+   evicting anything if the user pool is exhausted. */
+struct frame *
+frame_try_alloc (struct page *p)
+{
+  struct frame *f;
+
+  lock_acquire (&frame_lock);
+  f = frame_get (p, false, false);
+  lock_release (&frame_lock);
+  return f;
+}
+
+/* Obtains the cache frame holding the contents of file page P,
+   which must be page-aligned in its file, and makes P map it.
+   The frame is returned pinned, as by frame_alloc(), after
+   reading it in if it was not cached, in which case *LOADED is
+   set to true.  Returns a null pointer if no frame could be
+   obtained or the page could not be read. */
+struct frame *
+frame_share (struct page *p, bool *loaded)
+{
+  struct frame *f;
+
+  ASSERT (p->file != NULL && p->file_ofs % PGSIZE == 0);
+
+  lock_acquire (&frame_lock);
+  ASSERT (p->frame == NULL);
+  f = cache_get (file_get_inode (p->file), p->file_ofs / PGSIZE, loaded);
+  if (f != NULL)
+    {
+      list_push_back (&f->pages, &p->frame_elem);
+      page_set_frame (p, f);
+    }
+  lock_release (&frame_lock);
+  return f;
+}
+
+/* Maps file page P, as for frame_share(), if its cache frame is
+   already in memory.  Returns false, without reading anything,
+   if it is not. */
+bool
+frame_share_resident (struct page *p)
+{
+  struct radix_tree *tree;
+  struct frame *f;
+  bool success = false;
+
+  ASSERT (p->file != NULL && p->file_ofs % PGSIZE == 0);
+
+  lock_acquire (&frame_lock);
+  ASSERT (p->frame == NULL);
+  tree = inode_page_tree (file_get_inode (p->file));
+  f = radix_lookup (tree, p->file_ofs / PGSIZE);
+  if (f != NULL && !f->loading
+      && pagedir_set_page (p->owner->pagedir, p->upage, f->kpage,
+                           p->writable))
+    {
+      list_push_back (&f->pages, &p->frame_elem);
+      page_set_frame (p, f);
+      cache_hit_cnt++;
+      success = true;
+    }
+  lock_release (&frame_lock);
+  return success;
+}
+
+/* Returns the cache frame holding page PAGE_IDX of INODE, pinned,
+   reading it in if it was not cached.  If LOADED is nonnull,
+   sets *LOADED to whether it had to be read.  The caller must
+   unpin the frame with frame_unpin().  Returns a null pointer if
+   no frame could be obtained or the page could not be read. */
+struct frame *
+frame_cache_get (struct inode *inode, size_t page_idx, bool *loaded)
+{
+  struct frame *f;
+  bool dummy;
+
+  lock_acquire (&frame_lock);
+  f = cache_get (inode, page_idx, loaded != NULL ? loaded : &dummy);
+  if (f != NULL)
+    f->accessed = true;
+  lock_release (&frame_lock);
+  return f;
+}
+
+/* Copies the SIZE bytes at BUFFER into page PAGE_IDX of INODE,
+   starting OFS bytes into the page, if that page is cached.
+   Called after writing the same bytes to disk. */
+void
+frame_cache_update (struct inode *inode, size_t page_idx, size_t ofs,
+                    const void *buffer, size_t size)
+{
+  struct frame *f;
+
+  ASSERT (ofs + size <= PGSIZE);
+
+  lock_acquire (&frame_lock);
+  f = radix_lookup (inode_page_tree (inode), page_idx);
+  if (f != NULL)
+    {
+      /* A page being read in may have missed the write, and one
+         being written back must not change under the write. */
+      f->pin_cnt++;
+      while (f->loading)
+        cond_wait (&cache_loaded, &frame_lock);
+      while (f->cleaning)
+        cond_wait (&frame_cleaned, &frame_lock);
+      lock_release (&frame_lock);
+
+      memcpy ((uint8_t *) f->kpage + ofs, buffer, size);
+
+      lock_acquire (&frame_lock);
+      if (--f->pin_cnt == 0 && f->inode == NULL && list_empty (&f->pages))
+        frame_destroy (f);
+    }
+  lock_release (&frame_lock);
+}
+
+/* Drops every page of INODE from the page cache.  No page may
+   map them, so INODE must not be open. */
+void
+frame_cache_flush (struct inode *inode)
+{
+  struct radix_tree *tree = inode_page_tree (inode);
+  size_t page_cnt = DIV_ROUND_UP (inode_length (inode), PGSIZE);
+  size_t i;
+
+  lock_acquire (&frame_lock);
+  for (i = 0; i < page_cnt && !radix_empty (tree); i++)
+    {
+      struct frame *f = radix_lookup (tree, i);
+      if (f != NULL)
+        {
+          ASSERT (f->pin_cnt == 0 && list_empty (&f->pages));
+          frame_destroy (f);
+        }
+    }
+  ASSERT (radix_empty (tree));
+  lock_release (&frame_lock);
+}
+
+/* Returns true if page P is resident in a frame that other pages
+   map too.  The zero frame does not count: pages mapping it are
+   not resident (see page_set_frame()). */
+bool
+frame_is_shared (struct page *p)
+{
+  struct frame *f;
+  bool shared;
+
+  lock_acquire (&frame_lock);
+  f = p->frame;
+  shared = (f != NULL && f != &zero_frame
+            && list_begin (&f->pages) != list_rbegin (&f->pages));
+  lock_release (&frame_lock);
+  return shared;
+}
+
+/* Returns true if F is the shared frame of zeros. */
+bool
+frame_is_zero (const struct frame *f)
+{
+  return f == &zero_frame;
+}
+
+/* Maps anonymous page P, which has never been written, to the
+   shared zero frame, read-only.  Returns false if the page table
+   cannot be allocated. */
+bool
+frame_zero (struct page *p)
+{
+  bool success;
+
+  ASSERT (p->file == NULL && p->swap_slot == SWAP_SLOT_NONE);
+
+  lock_acquire (&frame_lock);
+  ASSERT (p->frame == NULL);
+  success = pagedir_set_page (p->owner->pagedir, p->upage, zero_frame.kpage,
+                              false);
+  if (success)
+    {
+      list_push_back (&zero_frame.pages, &p->frame_elem);
+      page_set_frame (p, &zero_frame);
+      zero_map_cnt++;
+    }
+  lock_release (&frame_lock);
+  return success;
+}
+
+/* Obtains a pinned frame for page P, or for the page cache if P
+   is a null pointer, evicting if MAY_EVICT is true and the user
+   pool is exhausted.  If ZERO is true, the frame is filled with
+   zeros. */
+static struct frame *
+frame_get (struct page *p, bool may_evict, bool zero)
+{
+  struct frame *f = NULL;
+  void *kpage;
+
+  ASSERT (lock_held_by_current_thread (&frame_lock));
+  ASSERT (p == NULL || p->frame == NULL);
+
+  kpage = palloc_get_page (PAL_USER | (zero ? PAL_ZERO : 0));
+  if (kpage != NULL)
+    {
+      f = malloc (sizeof *f);
+      if (f == NULL)
+        palloc_free_page (kpage);
+      else
+        {
+          f->kpage = kpage;
+          f->merge_listed = false;
+          list_push_back (&frame_list, &f->elem);
+        }
+    }
+  else if (may_evict)
+    {
+      /* Take a frame away from some other page. */
+      direct_evict_cnt++;
+      f = pick_victim ();
+      if (f != NULL)
+        {
+          if (f->inode != NULL)
+            evict_shared (f, false);
+          else if (!(frame_is_private (f) ? evict_cluster (f, false)
+                     : evict_cow (f, false)))
+            f = NULL;
+          if (f != NULL && zero)
+            memset (f->kpage, 0, PGSIZE);
+        }
+    }
+
+  if (f != NULL)
+    {
+      list_init (&f->pages);
+      f->pin_cnt = 1;
+      f->inode = NULL;
+      f->loading = false;
+      f->accessed = false;
+      f->cleaning = false;
+      merge_unlist (f);
+      f->checksum = 0;
+      if (p != NULL)
+        {
+          list_push_back (&f->pages, &p->frame_elem);
+          page_set_frame (p, f);
+        }
+    }
+
+  if (!reclaim_pending && palloc_user_available () < RECLAIM_LOW)
+    {
+      reclaim_pending = true;
+      sema_up (&reclaim_wake);
+    }
+  return f;
+}
+
+/* Makes CHILD, a page of the running process just created by
+   fork from PARENT in the parent process, share PARENT's
+   contents.  If PARENT is resident in an anonymous frame, both
+   pages map it read-only from now on; otherwise CHILD refers to
+   PARENT's swap slot, if any.  Pages in cache frames are left
+   for CHILD to find through frame_share() on its first access.
+   Returns false if CHILD cannot be mapped. */
+bool
+frame_fork (struct page *parent, struct page *child)
+{
+  uint32_t *ppd = parent->owner->pagedir;
+  struct frame *f;
+  bool success = true;
+
+  ASSERT (child->frame == NULL && child->swap_slot == SWAP_SLOT_NONE);
+
+  lock_acquire (&frame_lock);
+  f = wait_frame (parent);
+  if (f == NULL)
+    child->swap_slot = swap_dup (parent->swap_slot);
+  else if (f->inode == NULL)
+    {
+      /* A slot is shared only while it matches the frame, and a
+         read-only mapping loses the dirty bit. */
+      if (pagedir_is_dirty (ppd, parent->upage))
+        swap_free (parent);
+      page_unmap (parent);
+      pagedir_set_page (ppd, parent->upage, f->kpage, false);
+
+      if (pagedir_set_page (child->owner->pagedir, child->upage, f->kpage,
+                            false))
+        {
+          child->swap_slot = swap_dup (parent->swap_slot);
+          list_push_back (&f->pages, &child->frame_elem);
+          page_set_frame (child, f);
+          if (f != &zero_frame)
+            cow_share_cnt++;
+        }
+      else
+        success = false;
+    }
+  lock_release (&frame_lock);
+  return success;
+}
+
+/* Gives writable page P, which maps a copy-on-write frame or the
+   zero frame, a frame of its own and maps it writable.  If P is the last page
+   mapping the frame, it just becomes writable.  Returns false if
+   no frame is available. */
+bool
+frame_unshare (struct page *p)
+{
+  struct frame *f, *copy;
+  uint32_t *pd = p->owner->pagedir;
+  bool success = true;
+
+  ASSERT (p->writable);
+
+  lock_acquire (&frame_lock);
+  f = wait_frame (p);
+  if (f == NULL)
+    {
+      /* Evicted meanwhile: it will be paged in privately. */
+    }
+  else if (frame_is_private (f))
+    {
+      /* Already writable again if a write to P faulted while the
+         merge scanner had it write-protected; remapping it then
+         would lose its dirty bit. */
+      if (!pagedir_is_writable (pd, p->upage))
+        {
+          page_unmap (p);
+          pagedir_set_page (pd, p->upage, f->kpage, true);
+        }
+    }
+  else
+    {
+      ASSERT (f->inode == NULL);
+
+      /* Keep F from being chosen to make room for the copy. */
+      list_remove (&p->frame_elem);
+      page_set_frame (p, NULL);
+      f->pin_cnt++;
+      copy = frame_get (p, true, f == &zero_frame);
+      f->pin_cnt--;
+
+      if (copy != NULL)
+        {
+          if (f != &zero_frame)
+            memcpy (copy->kpage, f->kpage, PGSIZE);
+          page_unmap (p);
+          pagedir_set_page (pd, p->upage, copy->kpage, true);
+          copy->pin_cnt = 0;
+          if (f == &zero_frame)
+            zero_copy_cnt++;
+          else
+            cow_copy_cnt++;
+        }
+      else
+        {
+          list_push_back (&f->pages, &p->frame_elem);
+          page_set_frame (p, f);
+          success = false;
+        }
+    }
+  lock_release (&frame_lock);
+  return success;
+}
+
+/* Waits until the reclaim thread is done writing page P's
+   frame, if it is.  Returns true if P is still resident and
+   mapped afterward, false if P was not being written or has been
+   evicted. */
+bool
+frame_wait (struct page *p)
+{
+  bool resident;
+
+  lock_acquire (&frame_lock);
+  resident = (p->frame != NULL && p->frame->cleaning
+              && wait_frame (p) != NULL);
+  lock_release (&frame_lock);
+  return resident;
+}
+
+/* Drops one pin on frame F, making it eligible for eviction
+   again once no pins remain. */
+void
+frame_unpin (struct frame *f)
+{
+  lock_acquire (&frame_lock);
+  ASSERT (f->pin_cnt > 0);
+  f->pin_cnt--;
+  lock_release (&frame_lock);
+}
+
+/* Removes page P's mapping of its frame, if any, and releases
+   the frame back to the user pool if no other page maps it and it
+   is not in the page cache.  A dirty mapped page is written back
+   to its file first. */
+void
+frame_release (struct page *p)
+{
+  struct frame *f;
+
+  lock_acquire (&frame_lock);
+  f = wait_frame (p);
+  if (f != NULL)
+    {
+      page_unmap (p);
+      page_write_back (p);
+      list_remove (&p->frame_elem);
+      page_set_frame (p, NULL);
+      if (list_empty (&f->pages) && f != &zero_frame && f->inode == NULL)
+        frame_destroy (f);
+    }
+  lock_release (&frame_lock);
+}
+
+/* Prints frame sharing statistics. */
+void
+frame_print_stats (void)
+{
+  printf ("Frames: %lld shared by fork, %lld copied on write\n",
+          cow_share_cnt, cow_copy_cnt);
+  printf ("Page cache: %lld pages read in, %lld found resident\n",
+          cache_load_cnt, cache_hit_cnt);
+  printf ("Zero page: %lld pages mapped, %lld written\n",
+          zero_map_cnt, zero_copy_cnt);
+  printf ("Merging: %lld frames scanned, %lld freed (%lld into the zero "
+          "page), %lld pages merged\n",
+          merge_scan_cnt, merge_cnt, merge_zero_cnt, merge_page_cnt);
+  printf ("Reclaim: %lld wake-ups, %lld frames freed, %lld pages cleaned, "
+          "%lld frames evicted by faults\n",
+          reclaim_run_cnt, reclaim_cnt, clean_cnt, direct_evict_cnt);
+}
+
+/* Samples the accessed bits of the pages mapping the next CNT
+   frames on the frame list for the working-set sampler.  Returns
+   true once every frame on the list when the sweep began has been
+   sampled, after which the next call begins a new sweep. */
+bool
+frame_sample (size_t cnt)
+{
+  bool done;
+
+  lock_acquire (&frame_lock);
+  if (sample_left == 0)
+    sample_left = list_size (&frame_list);
+  for (; cnt > 0 && sample_left > 0 && !list_empty (&frame_list);
+       cnt--, sample_left--)
+    {
+      struct frame *f;
+      struct list_elem *e;
+
+      if (sample_hand == NULL || sample_hand == list_end (&frame_list))
+        sample_hand = list_begin (&frame_list);
+      f = list_entry (sample_hand, struct frame, elem);
+      sample_hand = list_next (sample_hand);
+
+      for (e = list_begin (&f->pages); e != list_end (&f->pages);
+           e = list_next (e))
+        page_sample (list_entry (e, struct page, frame_elem));
+    }
+  if (list_empty (&frame_list))
+    sample_left = 0;
+  done = sample_left == 0;
+  lock_release (&frame_lock);
+  return done;
+}
+
+/* Scans the next CNT frames on the frame list for the same-page
+   merging scanner, merging each with an identical frame if it
+   can.  Returns true once every frame on the list when the sweep
+   began has been scanned, after which the next call begins a new
+   sweep. */
+bool
+frame_merge_scan (size_t cnt)
+{
+  bool done;
+
+  lock_acquire (&frame_lock);
+  if (merge_left == 0)
+    merge_left = list_size (&frame_list);
+  for (; cnt > 0 && merge_left > 0 && !list_empty (&frame_list);
+       cnt--, merge_left--)
+    {
+      struct frame *f;
+
+      if (merge_hand == NULL || merge_hand == list_end (&frame_list))
+        merge_hand = list_begin (&frame_list);
+      f = list_entry (merge_hand, struct frame, elem);
+      merge_hand = list_next (merge_hand);
+      merge_scan_frame (f);
+    }
+  if (list_empty (&frame_list))
+    merge_left = 0;
+  done = merge_left == 0;
+  lock_release (&frame_lock);
+  return done;
+}
+
+/* Reclaim thread.  Each time it is woken up, frees frames until
+   RECLAIM_HIGH pages are available for user frames or nothing
+   more can be evicted. */
+static void
+reclaim_thread (void *aux UNUSED)
+{
+  for (;;)
+    {
+      sema_down (&reclaim_wake);
+
+      lock_acquire (&frame_lock);
+      reclaim_run_cnt++;
+      while (palloc_user_available () < RECLAIM_HIGH && reclaim_frame ())
+        {
+          /* Let waiting faults in between frames. */
+          lock_release (&frame_lock);
+          lock_acquire (&frame_lock);
+        }
+      reclaim_pending = false;
+      lock_release (&frame_lock);
+    }
+}
+
+/* Advances the clock hand to the first unpinned frame not
+   accessed since the hand last passed it and not in its
+   process's working set, and evicts it and frees it.  Cleans up
+   to RECLAIM_CLEAN_MAX of the private frames it passes that were
+   accessed but are outside the working set, and so will be
+   evicted if they stay idle until the next pass; frames in the
+   working set are likely to be written again before then.
+   Returns false if no frame could be evicted. */
+static bool
+reclaim_frame (void)
+{
+  size_t clean_left = RECLAIM_CLEAN_MAX;
+  size_t i, frame_cnt;
+
+  ASSERT (lock_held_by_current_thread (&frame_lock));
+
+  frame_cnt = list_size (&frame_list);
+  for (i = 0; i < 2 * frame_cnt; i++)
+    {
+      struct frame *f = clock_advance ();
+      bool accessed, in_wset;
+
+      if (f->pin_cnt > 0)
+        continue;
+      accessed = frame_test_and_clear_accessed (f);
+      in_wset = frame_in_wset (f);
+      if (accessed || in_wset)
+        {
+          if (accessed && !in_wset && clean_left > 0
+              && frame_is_private (f) && clean_frame (f))
+            clean_left--;
+          continue;
+        }
+
+      if (f->inode != NULL)
+        {
+          if (!evict_shared (f, true))
+            continue;
+        }
+      else if (!(frame_is_private (f) ? evict_cluster (f, true)
+                 : evict_cow (f, true)))
+        return false;
+      frame_destroy (f);
+      reclaim_cnt++;
+      return true;
+    }
+  return false;
+}
+
+/* Writes private frame F's page out to a new swap slot if it is
+   dirty, and marks it clean.  The page stays resident.  Returns
+   true if it wrote the page.
+
+   Releases the frame lock while writing, as io_start() allows.
+   The page keeps its old slot until the write is done.  The
+   dirty bit is cleared before the page is copied, so a write
+   that races with the copy dirties it again. */
+static bool
+clean_frame (struct frame *f)
+{
+  struct page *p = frame_page (f);
+  uint32_t *pd = p->owner->pagedir;
+  swap_slot_t slot;
+
+  ASSERT (lock_held_by_current_thread (&frame_lock));
+
+  if (!pagedir_is_dirty (pd, p->upage))
+    return false;
+
+  slot = swap_alloc (&p, 1);
+  if (slot == SWAP_SLOT_NONE)
+    return false;
+  pagedir_set_dirty (pd, p->upage, false);
+  io_start (f);
+  lock_release (&frame_lock);
+
+  swap_write (slot, f->kpage);
+
+  lock_acquire (&frame_lock);
+  io_done (f);
+  swap_free (p);
+  p->swap_slot = slot;
+  clean_cnt++;
+  return true;
+}
+
+/* Waits until the frame holding page P, if any, is not being
+   written by the reclaim thread, and returns it. */
+static struct frame *
+wait_frame (struct page *p)
+{
+  ASSERT (lock_held_by_current_thread (&frame_lock));
+
+  while (p->frame != NULL && p->frame->cleaning)
+    cond_wait (&frame_cleaned, &frame_lock);
+  return p->frame;
+}
+
+/* Pins frame F and marks it as being written, so that the frame
+   lock may be released for the write: nothing evicts or merges F
+   meanwhile, and whoever is about to fault in, remap, fork,
+   release or update a page mapping F waits until io_done(). */
+static void
+io_start (struct frame *f)
+{
+  ASSERT (!f->cleaning);
+
+  f->pin_cnt++;
+  f->cleaning = true;
+}
+
+/* Undoes io_start() once the frame lock is held again, and wakes
+   up whoever waits for F. */
+static void
+io_done (struct frame *f)
+{
+  ASSERT (f->cleaning && f->pin_cnt > 0);
+
+  f->cleaning = false;
+  f->pin_cnt--;
+  cond_broadcast (&frame_cleaned, &frame_lock);
+}
+
+/* Returns the frame under the clock hand and advances the hand,
+   wrapping around at the end of the frame list. */
+static struct frame *
+clock_advance (void)
+{
+  struct frame *f;
+
+  if (clock_hand == NULL || clock_hand == list_end (&frame_list))
+    clock_hand = list_begin (&frame_list);
+  f = list_entry (clock_hand, struct frame, elem);
+  clock_hand = list_next (clock_hand);
+  return f;
+}
+
+/* Returns true if any page mapping frame F has been accessed
+   since the last call, or F has been read through the page cache,
+   and clears their accessed bits. */
+static bool
+frame_test_and_clear_accessed (struct frame *f)
+{
+  struct list_elem *e;
+  bool accessed = f->accessed;
+
+  f->accessed = false;
+  for (e = list_begin (&f->pages); e != list_end (&f->pages);
+       e = list_next (e))
+    if (page_test_and_clear_accessed (list_entry (e, struct page,
+                                                  frame_elem)))
+      accessed = true;
+  return accessed;
+}
+
+/* Returns true if any page mapping frame F is in its process's
+   working set. */
+static bool
+frame_in_wset (struct frame *f)
+{
+  struct list_elem *e;
+
+  for (e = list_begin (&f->pages); e != list_end (&f->pages);
+       e = list_next (e))
+    if (wset_contains (list_entry (e, struct page, frame_elem)))
+      return true;
+  return false;
+}
+
+/* Runs the clock hand over the frame list and returns the first
+   unpinned frame whose pages have not been accessed since the
+   hand last passed it and are outside the working set, clearing
+   accessed bits along the way.  If every such frame is in the
+   working set, returns the first one found instead.  Returns a
+   null pointer if every frame is pinned. */
+static struct frame *
+pick_victim (void)
+{
+  struct frame *fallback = NULL;
+  size_t i, frame_cnt;
+
+  ASSERT (lock_held_by_current_thread (&frame_lock));
+
+  /* Two passes are enough: the first clears every accessed bit. */
+  frame_cnt = list_size (&frame_list);
+  for (i = 0; i < 2 * frame_cnt; i++)
+    {
+      struct frame *f = clock_advance ();
+      if (f->pin_cnt > 0 || frame_test_and_clear_accessed (f))
+        continue;
+      if (!frame_in_wset (f))
+        return f;
+      if (fallback == NULL)
+        fallback = f;
+    }
+  return fallback;
+}
+
+/* Evicts private frame VICTIM together with up to
+   SWAP_CLUSTER - 1 other unaccessed private frames of the same
+   process found by continuing the clock sweep.  The other
+   frames are returned to the user pool; VICTIM is kept for
+   reuse.  If UNLOCK is true, the frame lock is released while
+   they are written to swap.  Returns false if swap is full. */
+static bool
+evict_cluster (struct frame *victim, bool unlock)
+{
+  struct frame *frames[SWAP_CLUSTER];
+  struct page *pages[SWAP_CLUSTER];
+  struct thread *owner = frame_page (victim)->owner;
+  size_t cnt, evicted, i;
+
+  frames[0] = victim;
+  pages[0] = frame_page (victim);
+  cnt = 1;
+  for (i = 0; i < 2 * SWAP_CLUSTER && cnt < SWAP_CLUSTER; i++)
+    {
+      struct frame *f = clock_advance ();
+      if (f == victim)
+        break;
+      if (f->pin_cnt == 0 && frame_is_private (f)
+          && frame_page (f)->owner == owner
+          && !page_test_and_clear_accessed (frame_page (f))
+          && !wset_contains (frame_page (f)))
+        {
+          frames[cnt] = f;
+          pages[cnt] = frame_page (f);
+          cnt++;
+        }
+    }
+
+  if (unlock)
+    for (i = 0; i < cnt; i++)
+      io_start (frames[i]);
+  evicted = page_evict (pages, cnt, unlock ? &frame_lock : NULL);
+  if (unlock)
+    for (i = 0; i < cnt; i++)
+      io_done (frames[i]);
+  for (i = 1; i < evicted; i++)
+    frame_destroy (frames[i]);
+  return evicted > 0;
+}
+
+/* Evicts cache frame VICTIM, which is kept for reuse, by
+   unmapping it from every page that maps it and dropping it from
+   the page cache.  It is written back to its file if a mapping
+   dirtied it; otherwise the file already has its contents.
+
+   If UNLOCK is true, the frame lock is released during the
+   write-back.  VICTIM stays in the page cache meanwhile, and is
+   left there, and false returned, if a page maps it again or
+   someone pins it before the write is done.  Returns true
+   otherwise. */
+static bool
+evict_shared (struct frame *victim, bool unlock)
+{
+  bool dirty = false;
+
+  while (!list_empty (&victim->pages))
+    {
+      struct page *p = list_entry (list_pop_front (&victim->pages),
+                                   struct page, frame_elem);
+      page_unmap (p);
+      if (p->mapped && pagedir_is_dirty (p->owner->pagedir, p->upage))
+        dirty = true;
+      page_set_frame (p, NULL);
+    }
+  if (dirty)
+    {
+      if (unlock)
+        {
+          io_start (victim);
+          lock_release (&frame_lock);
+        }
+      cache_write_back (victim);
+      if (unlock)
+        {
+          lock_acquire (&frame_lock);
+          io_done (victim);
+          if (victim->pin_cnt > 0 || !list_empty (&victim->pages))
+            return false;
+        }
+    }
+  cache_drop (victim);
+  return true;
+}
+
+/* Evicts copy-on-write frame VICTIM, which is kept for reuse,
+   by writing it to swap unless its pages already share a slot,
+   and unmapping it from every page that maps it.  If UNLOCK is
+   true, the frame lock is released during the write.  Returns
+   false if swap is full. */
+static bool
+evict_cow (struct frame *victim, bool unlock)
+{
+  struct page *first = list_entry (list_front (&victim->pages),
+                                   struct page, frame_elem);
+  swap_slot_t slot = first->swap_slot;
+  bool written = false;
+
+  if (slot == SWAP_SLOT_NONE)
+    {
+      slot = swap_alloc (&first, 1);
+      if (slot == SWAP_SLOT_NONE)
+        return false;
+      if (unlock)
+        {
+          io_start (victim);
+          lock_release (&frame_lock);
+        }
+      swap_write (slot, victim->kpage);
+      if (unlock)
+        {
+          lock_acquire (&frame_lock);
+          io_done (victim);
+        }
+      written = true;
+    }
+
+  while (!list_empty (&victim->pages))
+    {
+      struct page *p = list_entry (list_pop_front (&victim->pages),
+                                   struct page, frame_elem);
+      ASSERT (p->swap_slot == (written ? SWAP_SLOT_NONE : slot));
+      page_unmap (p);
+      if (written)
+        p->swap_slot = p == first ? slot : swap_dup (slot);
+      page_set_frame (p, NULL);
+    }
+  return true;
+}
+
+/* Removes frame F from the frame table and frees it. */
+static void
+frame_destroy (struct frame *f)
+{
+  ASSERT (lock_held_by_current_thread (&frame_lock));
+
+  if (f->inode != NULL)
+    cache_drop (f);
+  if (clock_hand == &f->elem)
+    clock_hand = list_next (clock_hand);
+  if (sample_hand == &f->elem)
+    sample_hand = list_next (sample_hand);
+  if (merge_hand == &f->elem)
+    merge_hand = list_next (merge_hand);
+  merge_unlist (f);
+  list_remove (&f->elem);
+  palloc_free_page (f->kpage);
+  free (f);
+}
+
+/* Returns true if F is mapped by a single page and belongs to no
+   file.  The zero frame is never private. */
+static bool
+frame_is_private (struct frame *f)
+{
+  return (f->inode == NULL && f != &zero_frame && !list_empty (&f->pages)
+          && list_begin (&f->pages) == list_rbegin (&f->pages));
+}
+
+/* Returns the page mapping private frame F. */
+static struct page *
+frame_page (struct frame *f)
+{
+  ASSERT (frame_is_private (f));
+  return list_entry (list_front (&f->pages), struct page, frame_elem);
+}
+
+/* Returns the cache frame holding page PAGE_IDX of INODE,
+   pinned, reading it in if it was not cached, as for
+   frame_cache_get(), and sets *LOADED to whether it did.  May
+   release the frame lock while reading, or while waiting for
+   another thread to read it in. */
+static struct frame *
+cache_get (struct inode *inode, size_t page_idx, bool *loaded)
+{
+  struct radix_tree *tree = inode_page_tree (inode);
+  struct frame *f;
+  size_t bytes;
+  bool success;
+
+  ASSERT (lock_held_by_current_thread (&frame_lock));
+  ASSERT ((off_t) (page_idx * PGSIZE) < inode_length (inode));
+
+  *loaded = false;
+  f = radix_lookup (tree, page_idx);
+  if (f != NULL)
+    {
+      f->pin_cnt++;
+      while (f->loading)
+        cond_wait (&cache_loaded, &frame_lock);
+      if (f->inode == NULL)
+        {
+          /* The thread that was reading it in failed. */
+          if (--f->pin_cnt == 0)
+            frame_destroy (f);
+          return NULL;
+        }
+      cache_hit_cnt++;
+      return f;
+    }
+
+  f = frame_get (NULL, true, false);
+  if (f == NULL)
+    return NULL;
+  if (!radix_insert (tree, page_idx, f))
+    {
+      frame_destroy (f);
+      return NULL;
+    }
+  f->inode = inode;
+  f->page_idx = page_idx;
+  f->loading = true;
+  cache_load_cnt++;
+  *loaded = true;
+
+  /* Read it in without holding the lock. */
+  lock_release (&frame_lock);
+  bytes = cache_bytes (f);
+  success = (inode_read_uncached (inode, f->kpage, bytes, page_idx * PGSIZE)
+             == (off_t) bytes);
+  memset ((uint8_t *) f->kpage + bytes, 0, PGSIZE - bytes);
+  lock_acquire (&frame_lock);
+
+  f->loading = false;
+  cond_broadcast (&cache_loaded, &frame_lock);
+  if (!success)
+    {
+      cache_drop (f);
+      if (--f->pin_cnt == 0)
+        frame_destroy (f);
+      return NULL;
+    }
+  return f;
+}
+
+/* Removes cache frame F from the page cache.  This may free
+   its inode, if the inode is closed and F was its last cached
+   page. */
+static void
+cache_drop (struct frame *f)
+{
+  struct inode *inode = f->inode;
+
+  ASSERT (inode != NULL);
+
+  f->inode = NULL;
+  inode_uncache_page (inode, f->page_idx);
+}
+
+/* Writes the contents of cache frame F back to its file. */
+static void
+cache_write_back (struct frame *f)
+{
+  inode_write_uncached (f->inode, f->kpage, cache_bytes (f),
+                        f->page_idx * PGSIZE);
+}
+
+/* Returns the number of bytes of its file that cache frame F
+   holds, the rest of it being past the end of the file. */
+static size_t
+cache_bytes (const struct frame *f)
+{
+  off_t left = inode_length (f->inode) - f->page_idx * PGSIZE;
+
+  return left < PGSIZE ? (size_t) left : PGSIZE;
+}
+
+/* Returns true if F may be merged with an identical frame: it
+   is an unpinned anonymous frame, not the zero frame, mapped only
+   by writable pages that are not memory-mapped. */
+static bool
+frame_is_mergeable (struct frame *f)
+{
+  struct list_elem *e;
+
+  if (f->inode != NULL || f == &zero_frame || f->pin_cnt > 0
+      || list_empty (&f->pages))
+    return false;
+  for (e = list_begin (&f->pages); e != list_end (&f->pages);
+       e = list_next (e))
+    {
+      struct page *p = list_entry (e, struct page, frame_elem);
+      if (!p->writable || p->mapped)
+        return false;
+    }
+  return true;
+}
+
+/* Hashes frame F's contents and merges it with an identical
+   frame found in the merge table, or with the zero frame, if its
+   contents have not changed since it was last scanned.  Both
+   frames are write-protected while they are compared and merged,
+   and made writable again if they differ. */
+static void
+merge_scan_frame (struct frame *f)
+{
+  struct page *f_page;
+  struct hash_elem *e;
+  unsigned checksum;
+
+  if (!frame_is_mergeable (f))
+    return;
+  merge_scan_cnt++;
+
+  /* Leave frames that are still changing for the next sweep. */
+  checksum = hash_bytes (f->kpage, PGSIZE);
+  if (checksum != f->checksum)
+    {
+      merge_unlist (f);
+      f->checksum = checksum;
+      return;
+    }
+
+  f_page = merge_protect (f);
+  if (!memcmp (f->kpage, zero_frame.kpage, PGSIZE))
+    {
+      merge_frames (f, &zero_frame);
+      merge_zero_cnt++;
+      return;
+    }
+
+  if (f->merge_listed)
+    {
+      merge_unprotect (f_page);
+      return;
+    }
+  e = hash_insert (&merge_table, &f->merge_elem);
+  if (e != NULL)
+    {
+      struct frame *g = hash_entry (e, struct frame, merge_elem);
+      bool same = false;
+
+      if (frame_is_mergeable (g))
+        {
+          struct page *g_page = merge_protect (g);
+          same = !memcmp (f->kpage, g->kpage, PGSIZE);
+          if (!same)
+            merge_unprotect (g_page);
+        }
+      if (same)
+        merge_frames (f, g);
+      else
+        {
+          /* G has changed, or is busy: F replaces it. */
+          merge_unprotect (f_page);
+          hash_replace (&merge_table, &f->merge_elem);
+          g->merge_listed = false;
+          f->merge_listed = true;
+        }
+    }
+  else
+    {
+      merge_unprotect (f_page);
+      f->merge_listed = true;
+    }
+}
+
+/* Write-protects the page mapping frame F, if F is private and
+   the page is mapped writable, and returns it, or a null pointer
+   if there was nothing to protect; pages of other frames are
+   read-only already.  From then on any write to the page,
+   including one by the kernel, faults and waits in
+   frame_unshare() for the frame lock. */
+static struct page *
+merge_protect (struct frame *f)
+{
+  struct page *p;
+
+  if (!frame_is_private (f))
+    return NULL;
+  p = frame_page (f);
+  if (!pagedir_is_writable (p->owner->pagedir, p->upage))
+    return NULL;
+  pagedir_set_writable (p->owner->pagedir, p->upage, false);
+  return p;
+}
+
+/* Makes page P, returned by merge_protect(), writable again.  P
+   may be null. */
+static void
+merge_unprotect (struct page *p)
+{
+  if (p != NULL)
+    pagedir_set_writable (p->owner->pagedir, p->upage, true);
+}
+
+/* Moves every page mapping frame F to frame INTO, which has the
+   same contents, and frees F.  From then on they all map INTO
+   read-only, as a copy-on-write frame, and refer to the same swap
+   slot, or to none. */
+static void
+merge_frames (struct frame *f, struct frame *into)
+{
+  swap_slot_t slot = SWAP_SLOT_NONE;
+
+  ASSERT (f != into);
+
+  if (frame_is_private (into))
+    {
+      /* A read-only mapping loses the dirty bit, so the slot
+         might not match once it is gone. */
+      struct page *p = frame_page (into);
+      swap_free (p);
+      page_unmap (p);
+      pagedir_set_page (p->owner->pagedir, p->upage, into->kpage, false);
+    }
+  else if (into != &zero_frame)
+    slot = list_entry (list_front (&into->pages), struct page,
+                       frame_elem)->swap_slot;
+
+  while (!list_empty (&f->pages))
+    {
+      struct page *p = list_entry (list_pop_front (&f->pages),
+                                   struct page, frame_elem);
+
+      /* P was mapped, so its page table exists and this
+         succeeds. */
+      swap_free (p);
+      page_unmap (p);
+      pagedir_set_page (p->owner->pagedir, p->upage, into->kpage, false);
+      p->swap_slot = swap_dup (slot);
+      list_push_back (&into->pages, &p->frame_elem);
+      page_set_frame (p, into);
+      merge_page_cnt++;
+    }
+  frame_destroy (f);
+  merge_cnt++;
+}
+
+/* Removes F from the merge table if it is there. */
+static void
+merge_unlist (struct frame *f)
+{
+  if (f->merge_listed)
+    {
+      hash_delete (&merge_table, &f->merge_elem);
+      f->merge_listed = false;
+    }
+}
+
+/* Returns frame E's checksum as its hash value. */
+static unsigned
+merge_hash (const struct hash_elem *e, void *aux UNUSED)
+{
+  return hash_entry (e, struct frame, merge_elem)->checksum;
+}
+
+/* Returns true if frame A's checksum is less than frame B's. */
+static bool
+merge_less (const struct hash_elem *a, const struct hash_elem *b,
+            void *aux UNUSED)
+{
+  return (hash_entry (a, struct frame, merge_elem)->checksum
+          < hash_entry (b, struct frame, merge_elem)->checksum);
+}
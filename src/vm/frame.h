@@ -0,0 +1,68 @@
+#ifndef VM_FRAME_H
+#define VM_FRAME_H
+
+#include <hash.h>
+#include <list.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "filesys/off_t.h"
+
+struct page;
+struct inode;
+
+/* A physical frame from the user pool.
+
+   A private frame is mapped by exactly one page.  A cache frame
+   holds page PAGE_IDX of the file whose inode is INODE, zeroed
+   past the end of the file, and is mapped by every page, in any
+   process, that maps that page of the file; it stays in the page
+   cache when no page maps it.  A copy-on-write frame holds an
+   anonymous page shared by a process and the children it
+   forked, and is mapped read-only by each of them.  The zero
+   frame, mapped read-only by every page that has only been read
+   so far and so is all zeros, is never private. */
+struct frame
+  {
+    void *kpage;                /* Kernel virtual address of the frame. */
+    struct list pages;          /* Pages mapped to the frame. */
+    unsigned pin_cnt;           /* Nonzero if the frame must not be evicted. */
+    struct list_elem elem;      /* Element in the frame list. */
+    bool cleaning;              /* Being written by the reclaim thread? */
+
+    /* Cache frames only. */
+    struct inode *inode;        /* File cached, or null if not cached. */
+    size_t page_idx;            /* Page number within INODE. */
+    bool loading;               /* Still being read in? */
+    bool accessed;              /* Read through the cache lately? */
+
+    /* Anonymous frames only. */
+    unsigned checksum;          /* Hash of contents when last scanned. */
+    struct hash_elem merge_elem; /* Element in the merge table. */
+    bool merge_listed;          /* In the merge table? */
+  };
+
+void frame_init (void);
+void frame_start_reclaim (void);
+struct frame *frame_alloc (struct page *);
+struct frame *frame_alloc_zeroed (struct page *);
+struct frame *frame_try_alloc (struct page *);
+struct frame *frame_share (struct page *, bool *loaded);
+bool frame_share_resident (struct page *);
+struct frame *frame_cache_get (struct inode *, size_t page_idx,
+                               bool *loaded);
+void frame_cache_update (struct inode *, size_t page_idx, size_t ofs,
+                         const void *, size_t size);
+void frame_cache_flush (struct inode *);
+bool frame_is_shared (struct page *);
+bool frame_is_zero (const struct frame *);
+bool frame_zero (struct page *);
+bool frame_fork (struct page *parent, struct page *child);
+bool frame_unshare (struct page *);
+bool frame_wait (struct page *);
+void frame_unpin (struct frame *);
+void frame_release (struct page *);
+bool frame_sample (size_t cnt);
+bool frame_merge_scan (size_t cnt);
+void frame_print_stats (void);
+
+#endif /* vm/frame.h */
@@ -0,0 +1,86 @@
+#include "vm/heap.h"
+#include <debug.h>
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "userprog/pagedir.h"
+#include "vm/page.h"
+
+/* The user heap.
+
+   A process's heap runs from the page after its last loaded
+   segment up to its "break", which sbrk() moves.  Growing the
+   heap only adds zero-filled pages to the supplemental page
+   table, so heap memory costs nothing until it is touched, and
+   reading it before writing maps the shared zero frame.
+   Shrinking it drops the pages past the new break.  The heap may
+   not grow into the range reserved for the stack, nor over a
+   memory-mapped file or any other page already in use: there is
+   no check for those up front, but page_create() refuses to add
+   a page that is already in the table. */
+
+/* Starts the running process's heap at the page boundary at or
+   after END, the end of its loaded segments. */
+void
+heap_init (void *end)
+{
+  struct thread *t = thread_current ();
+
+  t->heap_start = t->heap_brk = pg_round_up (end);
+}
+
+/* Gives the running process the same heap bounds as PARENT.  The
+   pages themselves are copied along with the rest of the
+   supplemental page table. */
+void
+heap_fork (struct thread *parent)
+{
+  struct thread *t = thread_current ();
+
+  t->heap_start = parent->heap_start;
+  t->heap_brk = parent->heap_brk;
+}
+
+/* Moves the running process's break by INCREMENT bytes, which
+   may be negative, and returns the old break.  Returns
+   SBRK_FAILED, leaving the break unchanged, if the break would
+   move below the start of the heap or into the stack, a page
+   the heap would grow into is already in use, as by a
+   memory-mapped file, or memory is short. */
+void *
+heap_sbrk (intptr_t increment)
+{
+  struct thread *t = thread_current ();
+  uint8_t *old_brk = t->heap_brk;
+  uint8_t *new_brk = old_brk + increment;
+  uint8_t *old_end = pg_round_up (old_brk);
+  uint8_t *new_end = pg_round_up (new_brk);
+  uint8_t *stack_limit = (uint8_t *) PHYS_BASE - stack_page_limit * PGSIZE;
+  uint8_t *upage;
+
+  if (t->heap_start == NULL)
+    return SBRK_FAILED;
+
+  if (increment > 0)
+    {
+      if (new_brk < old_brk || new_brk > stack_limit)
+        return SBRK_FAILED;
+      /* Fails on a page already in use. */
+      for (upage = old_end; upage < new_end; upage += PGSIZE)
+        if (page_create (upage, true) == NULL)
+          {
+            page_remove_range (old_end, (upage - old_end) / PGSIZE);
+            return SBRK_FAILED;
+          }
+    }
+  else if (increment < 0)
+    {
+      if (new_brk > old_brk || new_brk < t->heap_start)
+        return SBRK_FAILED;
+      pagedir_clear_range (t->pagedir, new_end,
+                           (old_end - new_end) / PGSIZE);
+      page_remove_range (new_end, (old_end - new_end) / PGSIZE);
+    }
+
+  t->heap_brk = new_brk;
+  return old_brk;
+}
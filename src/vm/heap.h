@@ -0,0 +1,13 @@
+#ifndef VM_HEAP_H
+#define VM_HEAP_H
+
+#include <stdint.h>
+#include "lib/user/syscall.h"
+
+struct thread;
+
+void heap_init (void *end);
+void heap_fork (struct thread *parent);
+void *heap_sbrk (intptr_t increment);
+
+#endif /* vm/heap.h */
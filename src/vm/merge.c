@@ -0,0 +1,82 @@
+#include "vm/merge.h"
+#include <debug.h>
+#include "devices/timer.h"
+#include "threads/interrupt.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "vm/frame.h"
+
+/* Same-page merging.
+
+   Processes running the same program on similar inputs often
+   hold byte-identical anonymous pages.  Every MERGE_INTERVAL
+   ticks, the timer interrupt wakes a kernel thread that scans the
+   next MERGE_SCAN_FRAMES frames on the frame list, a batch of
+   SCAN_BATCH at a time, and merges each one whose contents match
+   another frame's into a single copy-on-write frame (see
+   frame_merge_scan()).  A process that later writes to a merged
+   page gets its own copy again through the same page fault path
+   as after a fork.
+
+   Together the two settings give the scan rate: by default, 64
+   frames ten times a second. */
+
+/* Frames scanned with the frame table's lock held. */
+#define SCAN_BATCH 16
+
+unsigned merge_interval = TIMER_FREQ / 10;
+size_t merge_scan_frames = 64;
+
+static struct semaphore scan_wake;      /* Upped to start a scan. */
+static bool scan_pending;               /* SCAN_WAKE upped? */
+static bool started;                    /* Scanner thread running? */
+
+static thread_func scan_thread;
+
+/* Starts the scanner thread. */
+void
+merge_init (void)
+{
+  sema_init (&scan_wake, 0);
+  scan_pending = false;
+  if (thread_create ("merge", PRI_DEFAULT, scan_thread, NULL) != TID_ERROR)
+    started = true;
+}
+
+/* Called by the timer interrupt handler at each timer tick.
+   Wakes the scanner every MERGE_INTERVAL ticks, unless it is
+   still busy with the last scan. */
+void
+merge_tick (int64_t ticks)
+{
+  ASSERT (intr_context ());
+
+  if (started && merge_interval > 0 && merge_scan_frames > 0
+      && ticks % merge_interval == 0 && !scan_pending)
+    {
+      scan_pending = true;
+      sema_up (&scan_wake);
+    }
+}
+
+/* Scanner thread.  Each time it is woken up, scans the next
+   MERGE_SCAN_FRAMES frames, yielding between batches. */
+static void
+scan_thread (void *aux UNUSED)
+{
+  for (;;)
+    {
+      size_t left;
+
+      sema_down (&scan_wake);
+      for (left = merge_scan_frames; left > 0; )
+        {
+          size_t cnt = left < SCAN_BATCH ? left : SCAN_BATCH;
+          if (frame_merge_scan (cnt))
+            break;
+          left -= cnt;
+          thread_yield ();
+        }
+      scan_pending = false;
+    }
+}
@@ -0,0 +1,16 @@
+#ifndef VM_MERGE_H
+#define VM_MERGE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Ticks between scans; 0 disables merging. */
+extern unsigned merge_interval;
+
+/* Frames scanned each time. */
+extern size_t merge_scan_frames;
+
+void merge_init (void);
+void merge_tick (int64_t ticks);
+
+#endif /* vm/merge.h */
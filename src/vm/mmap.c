@@ -0,0 +1,170 @@
+#include "vm/mmap.h"
+#include <debug.h>
+#include <list.h>
+#include <round.h>
+#include "filesys/file.h"
+#include "filesys/filesys.h"
+#include "filesys/inode.h"
+#include "threads/malloc.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "userprog/pagedir.h"
+#include "vm/page.h"
+
+/* Memory-mapped files.
+
+   Mapping a file only records its pages in the supplemental
+   page table, with the file as their backing store; nothing is
+   read until a page is touched, and then the page maps the
+   file's page in the page cache, shared with read() and with
+   other mappings of the file.  Dirty pages go back to the file
+   instead of to swap, when they are evicted and when the mapping
+   is removed.  Clean pages are simply dropped.
+
+   The code of executables is mapped from the page cache too, so
+   a running executable cannot be mapped, and a mapped file
+   cannot be run. */
+
+/* A mapping of a file into the address space of a process. */
+struct mmap_region
+  {
+    mapid_t id;                 /* Mapping identifier. */
+    struct file *file;          /* Private handle on the mapped file. */
+    uint8_t *addr;              /* First mapped page. */
+    size_t page_cnt;            /* Number of mapped pages. */
+    struct list_elem elem;      /* Element in thread's `mmaps'. */
+  };
+
+static struct mmap_region *lookup_region (mapid_t);
+static void unmap_region (struct mmap_region *);
+
+/* Maps FILE into the running process's address space starting at
+   page-aligned ADDR.  Returns the new mapping's identifier, or
+   MAP_FAILED if FILE is empty, ADDR is misaligned or null, the
+   mapping would overlap pages already in use, or FILE is a
+   running executable. */
+mapid_t
+mmap_map (struct file *file, void *addr_)
+{
+  struct thread *t = thread_current ();
+  uint8_t *addr = addr_;
+  struct mmap_region *m;
+  off_t length;
+  size_t page_cnt, i;
+
+  if (addr == NULL || pg_ofs (addr) != 0)
+    return MAP_FAILED;
+  lock_acquire (&filesys_lock);
+  length = file_length (file);
+  lock_release (&filesys_lock);
+  if (length == 0)
+    return MAP_FAILED;
+
+  page_cnt = DIV_ROUND_UP (length, PGSIZE);
+  for (i = 0; i < page_cnt; i++)
+    {
+      uint8_t *upage = addr + i * PGSIZE;
+      if (upage < addr || !is_user_vaddr (upage)
+          || page_lookup (t, upage) != NULL)
+        return MAP_FAILED;
+    }
+
+  m = malloc (sizeof *m);
+  if (m == NULL)
+    return MAP_FAILED;
+  lock_acquire (&filesys_lock);
+  m->file = file_reopen (file);
+  if (m->file != NULL && !inode_map_writable (file_get_inode (m->file)))
+    {
+      file_close (m->file);
+      m->file = NULL;
+    }
+  lock_release (&filesys_lock);
+  if (m->file == NULL)
+    {
+      free (m);
+      return MAP_FAILED;
+    }
+  m->addr = addr;
+  m->page_cnt = page_cnt;
+
+  for (i = 0; i < page_cnt; i++)
+    {
+      off_t ofs = i * PGSIZE;
+      struct page *p = page_create (addr + ofs, true);
+      if (p == NULL)
+        {
+          page_remove_range (addr, i);
+          lock_acquire (&filesys_lock);
+          inode_unmap_writable (file_get_inode (m->file));
+          file_close (m->file);
+          lock_release (&filesys_lock);
+          free (m);
+          return MAP_FAILED;
+        }
+      p->file = m->file;
+      p->file_ofs = ofs;
+      p->read_bytes = length - ofs < PGSIZE ? length - ofs : PGSIZE;
+      p->mapped = true;
+    }
+
+  m->id = t->next_mapid++;
+  list_push_back (&t->mmaps, &m->elem);
+  return m->id;
+}
+
+/* Removes mapping ID from the running process, writing its dirty
+   pages back to the file.  Returns false if there is no such
+   mapping. */
+bool
+mmap_unmap (mapid_t id)
+{
+  struct mmap_region *m = lookup_region (id);
+
+  if (m == NULL)
+    return false;
+  unmap_region (m);
+  return true;
+}
+
+/* Removes all of the running process's mappings. */
+void
+mmap_unmap_all (void)
+{
+  struct list *mmaps = &thread_current ()->mmaps;
+
+  while (!list_empty (mmaps))
+    unmap_region (list_entry (list_front (mmaps), struct mmap_region, elem));
+}
+
+/* Returns the running process's mapping ID, or a null pointer. */
+static struct mmap_region *
+lookup_region (mapid_t id)
+{
+  struct list *mmaps = &thread_current ()->mmaps;
+  struct list_elem *e;
+
+  for (e = list_begin (mmaps); e != list_end (mmaps); e = list_next (e))
+    {
+      struct mmap_region *m = list_entry (e, struct mmap_region, elem);
+      if (m->id == id)
+        return m;
+    }
+  return NULL;
+}
+
+/* Removes mapping M and frees it. */
+static void
+unmap_region (struct mmap_region *m)
+{
+  /* Unmap the whole region in one go, to invalidate the TLB once
+     for all of it.  The dirty bits survive for the write-back. */
+  pagedir_clear_range (thread_current ()->pagedir, m->addr, m->page_cnt);
+  page_remove_range (m->addr, m->page_cnt);
+  list_remove (&m->elem);
+  lock_acquire (&filesys_lock);
+  inode_unmap_writable (file_get_inode (m->file));
+  file_close (m->file);
+  lock_release (&filesys_lock);
+  free (m);
+}
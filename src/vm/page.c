@@ -0,0 +1,697 @@
+#include "vm/page.h"
+#include <debug.h>
+#include <string.h>
+#include "filesys/file.h"
+#include "filesys/inode.h"
+#include "threads/malloc.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+#include "userprog/pagedir.h"
+#include "userprog/syscall.h"
+#include "vm/frame.h"
+#include "vm/wset.h"
+
+/* Supplemental page table.
+
+   Each process keeps a hash table of `struct page', keyed by
+   user virtual address, describing every page in its address
+   space.  A page is either resident, in which case FRAME points
+   to the frame holding it and the hardware page table maps it,
+   or evicted, in which case its contents live in SWAP_SLOT.  A
+   page that is neither has never been touched and reads as
+   zeros; reading it maps the shared zero frame, and only the
+   first write gives it a frame of its own.  A resident page may
+   keep its swap slot, as long as it stays clean, so that
+   evicting it again costs no I/O.  For the same reason, a page
+   loaded from a file goes to swap only once it has been written
+   to; until then it is simply read from the file again.
+
+   The stack starts out as a single page below PHYS_BASE.  A
+   fault just below the stack pointer adds pages to it, down to
+   STACK_PAGE_LIMIT pages below PHYS_BASE; see page_grow_stack().
+   Pages added this way stay in the table until the process
+   exits, like any other.
+
+   Each process counts its resident pages, kept up to date by
+   page_set_frame(), and the page faults it took that had to read
+   from a file or from swap ("major" faults).  page_memstat()
+   reports them together with the rest of its memory usage. */
+
+/* Maximum size of a user stack, in pages.  Set with -sl.  The
+   default is 8 MB. */
+size_t stack_page_limit = 2048;
+
+/* Size of the window mapped around a faulting page, in pages.
+   Set with -fa.  0 or 1 turns fault-around off. */
+size_t fault_around_pages = 16;
+
+/* Number of pages mapped by fault-around. */
+long long fault_around_cnt;
+
+/* An access may fault this far below the stack pointer: PUSHA
+   checks the lowest of the 32 bytes it pushes first. */
+#define STACK_SLOP 32
+
+static bool evict_run (struct page **, size_t cnt, bool *dirty,
+                       struct lock *io_lock);
+static void remap (struct page *, bool dirty);
+static void settle_readahead (struct page *);
+static void collect_accessed (struct page *);
+static bool page_load (struct page *, bool write);
+static bool page_maps_cache (const struct page *);
+static void fault_around (struct page *);
+static bool page_in_swap (struct page *);
+static bool page_in_shared (struct page *);
+
+static hash_hash_func page_hash;
+static hash_less_func page_less;
+static hash_action_func page_destroy;
+
+/* Initializes PAGES as an empty supplemental page table.
+   Returns false if memory allocation fails. */
+bool
+page_table_init (struct hash *pages)
+{
+  return hash_init (pages, page_hash, page_less, NULL);
+}
+
+/* Frees every page in PAGES, along with its frame and swap slot.
+   Must be called while the owner's page directory is still
+   alive. */
+void
+page_table_destroy (struct hash *pages)
+{
+  hash_destroy (pages, page_destroy);
+}
+
+/* Adds a page at UPAGE to the current process's supplemental
+   page table.  The page starts out non-resident and zero-filled.
+   Returns the new page, or a null pointer if UPAGE is already
+   in use or memory allocation fails. */
+struct page *
+page_create (void *upage, bool writable)
+{
+  struct thread *t = thread_current ();
+  struct page *p;
+
+  ASSERT (pg_ofs (upage) == 0);
+  ASSERT (is_user_vaddr (upage));
+
+  p = malloc (sizeof *p);
+  if (p == NULL)
+    return NULL;
+
+  p->upage = upage;
+  p->owner = t;
+  p->writable = writable;
+  p->frame = NULL;
+  p->swap_slot = SWAP_SLOT_NONE;
+  p->readahead = false;
+  p->age = 0;
+  p->clock_ref = p->sample_ref = false;
+  p->file = NULL;
+  p->file_ofs = 0;
+  p->read_bytes = 0;
+  p->mapped = false;
+  if (hash_insert (&t->pages, &p->hash_elem) != NULL)
+    {
+      free (p);
+      return NULL;
+    }
+  return p;
+}
+
+/* Copies PARENT's supplemental page table into the running
+   process's, which must be empty, sharing the contents of every
+   page with PARENT copy-on-write.  Memory-mapped pages are not
+   inherited.  Returns false if memory allocation fails. */
+bool
+page_table_fork (struct thread *parent)
+{
+  struct thread *cur = thread_current ();
+  struct hash_iterator i;
+
+  hash_first (&i, &parent->pages);
+  while (hash_next (&i))
+    {
+      struct page *pp = hash_entry (hash_cur (&i), struct page, hash_elem);
+      struct page *cp;
+
+      if (pp->mapped)
+        continue;
+
+      cp = page_create (pp->upage, pp->writable);
+      if (cp == NULL)
+        return false;
+      if (pp->file != NULL)
+        {
+          /* Segments of the executable, which the child has
+             reopened as its own. */
+          ASSERT (pp->file == parent->exec_file);
+          cp->file = cur->exec_file;
+          cp->file_ofs = pp->file_ofs;
+          cp->read_bytes = pp->read_bytes;
+        }
+      if (!frame_fork (pp, cp))
+        return false;
+    }
+  return true;
+}
+
+/* Returns the page in T's supplemental page table that contains
+   user address UADDR, or a null pointer if there is none. */
+struct page *
+page_lookup (struct thread *t, const void *uaddr)
+{
+  struct page key;
+  struct hash_elem *e;
+
+  if (!is_user_vaddr (uaddr))
+    return NULL;
+
+  key.upage = pg_round_down (uaddr);
+  e = hash_find (&t->pages, &key.hash_elem);
+  return e != NULL ? hash_entry (e, struct page, hash_elem) : NULL;
+}
+
+/* Removes page P from the running process's supplemental page
+   table and frees it, writing it back first if it is a dirty
+   mapped page. */
+void
+page_remove (struct page *p)
+{
+  ASSERT (p->owner == thread_current ());
+
+  hash_delete (&p->owner->pages, &p->hash_elem);
+  page_destroy (&p->hash_elem, NULL);
+}
+
+/* Removes the PAGE_CNT pages starting at UPAGE, which must all be
+   in the running process's supplemental page table, as
+   page_remove() would one by one. */
+void
+page_remove_range (void *upage, size_t page_cnt)
+{
+  struct thread *t = thread_current ();
+  uint8_t *addr = upage;
+  size_t i;
+
+  for (i = 0; i < page_cnt; i++)
+    page_remove (page_lookup (t, addr + i * PGSIZE));
+}
+
+/* Brings the current process's page containing FAULT_ADDR into
+   memory and maps it, along with any neighbours that are cheap to
+   map (see fault_around()).  WRITE is true if the page is about
+   to be written; a page that still reads as all zeros is
+   otherwise mapped to the shared zero frame until it is.  Returns
+   true if successful, false if FAULT_ADDR is not part of the
+   address space or no frame is available. */
+bool
+page_in (void *fault_addr, bool write)
+{
+  struct page *p = page_lookup (thread_current (), fault_addr);
+
+  if (p == NULL)
+    return false;
+  if (frame_wait (p))
+    {
+      /* The reclaim thread left it in memory after all. */
+      return true;
+    }
+  if (!page_load (p, write))
+    return false;
+  fault_around (p);
+  return true;
+}
+
+/* Brings page P into memory and maps it, as for page_in(). */
+static bool
+page_load (struct page *p, bool write)
+{
+  struct frame *f;
+
+  if (p->swap_slot != SWAP_SLOT_NONE)
+    return page_in_swap (p);
+  if (page_maps_cache (p))
+    return page_in_shared (p);
+  if (p->file == NULL && !write)
+    return frame_zero (p);
+
+  f = p->file != NULL ? frame_alloc (p) : frame_alloc_zeroed (p);
+  if (f == NULL)
+    return false;
+
+  if (p->file != NULL)
+    {
+      /* Copy it out of the page cache. */
+      struct frame *cf;
+      bool loaded;
+
+      cf = frame_cache_get (file_get_inode (p->file), p->file_ofs / PGSIZE,
+                            &loaded);
+      if (cf == NULL)
+        {
+          frame_release (p);
+          return false;
+        }
+      if (loaded)
+        p->owner->major_fault_cnt++;
+      memcpy (f->kpage, cf->kpage, p->read_bytes);
+      frame_unpin (cf);
+      memset ((uint8_t *) f->kpage + p->read_bytes, 0,
+              PGSIZE - p->read_bytes);
+    }
+  return page_map (p);
+}
+
+/* Returns true if file page P maps its page of the file in the
+   page cache directly: P is memory-mapped, or it is read-only and
+   holds a whole page of the file, or the rest of the file.  Other
+   file pages get a private copy. */
+static bool
+page_maps_cache (const struct page *p)
+{
+  return (p->file != NULL
+          && (p->mapped
+              || (!p->writable
+                  && (p->read_bytes == PGSIZE
+                      || (p->file_ofs + (off_t) p->read_bytes
+                          == file_length (p->file))))));
+}
+
+/* Maps the non-resident pages in the FAULT_AROUND_PAGES-page
+   aligned window around just faulted page P that can be mapped
+   without I/O or a new frame: file pages that map the page cache
+   and are already cached, and untouched anonymous pages,
+   which get the zero frame.  This saves the process the faults it
+   would otherwise take on them one by one. */
+static void
+fault_around (struct page *p)
+{
+  uintptr_t window = fault_around_pages * PGSIZE;
+  uint8_t *start, *upage;
+
+  if (fault_around_pages < 2)
+    return;
+
+  start = (uint8_t *) ((uintptr_t) p->upage / window * window);
+  for (upage = start; upage < start + window && is_user_vaddr (upage);
+       upage += PGSIZE)
+    {
+      struct page *q = page_lookup (p->owner, upage);
+      bool mapped;
+
+      if (q == NULL || q->frame != NULL)
+        continue;
+      else if (page_maps_cache (q))
+        mapped = frame_share_resident (q);
+      else if (q->file == NULL && q->swap_slot == SWAP_SLOT_NONE)
+        mapped = frame_zero (q);
+      else
+        continue;
+
+      if (mapped)
+        fault_around_cnt++;
+    }
+}
+
+/* Handles a write fault on the current process's page
+   containing FAULT_ADDR, which is resident but mapped read-only
+   because it is shared copy-on-write.  Returns true if
+   successful, false if the page is not writable or no frame is
+   available. */
+bool
+page_unshare (void *fault_addr)
+{
+  struct page *p = page_lookup (thread_current (), fault_addr);
+
+  return p != NULL && p->writable && frame_unshare (p);
+}
+
+/* Returns true if an access to UADDR by a process whose stack
+   pointer is ESP should be taken as an access to its stack: UADDR
+   is at most STACK_SLOP bytes below ESP and within
+   STACK_PAGE_LIMIT pages of PHYS_BASE. */
+bool
+page_is_stack_access (const void *uaddr, const void *esp)
+{
+  uintptr_t addr = (uintptr_t) uaddr;
+
+  return (is_user_vaddr (uaddr)
+          && addr + STACK_SLOP >= (uintptr_t) esp
+          && addr >= (uintptr_t) PHYS_BASE - stack_page_limit * PGSIZE);
+}
+
+/* Grows the current process's stack to cover FAULT_ADDR, which
+   faulted while the stack pointer was ESP, and brings in the new
+   page.  Returns false if FAULT_ADDR does not look like a stack
+   access or no memory is available. */
+bool
+page_grow_stack (void *fault_addr, const void *esp)
+{
+  if (!page_is_stack_access (fault_addr, esp))
+    return false;
+
+  return (page_create (pg_round_down (fault_addr), true) != NULL
+          && page_in (fault_addr, true));
+}
+
+/* Brings in file page P by mapping its page of the file in the
+   page cache, which every other page mapping the same page of the
+   file shares, reading it from the file only if it is not cached. */
+static bool
+page_in_shared (struct page *p)
+{
+  bool loaded;
+
+  if (frame_share (p, &loaded) == NULL)
+    return false;
+  if (loaded)
+    p->owner->major_fault_cnt++;
+  return page_map (p);
+}
+
+/* Reads swapped-out page P back in, together with the pages of
+   the same process in the slots around it, as long as frames are
+   free for them.  The neighbours are mapped too and marked as
+   read ahead. */
+static bool
+page_in_swap (struct page *p)
+{
+  /* P sits in the middle of RUN, at index CENTER, so the run can
+     grow by up to SWAP_CLUSTER - 1 pages in either direction. */
+  enum { CENTER = SWAP_CLUSTER - 1 };
+  struct page *run[2 * SWAP_CLUSTER - 1];
+  void *kpages[2 * SWAP_CLUSTER - 1];
+  size_t lo, hi, cnt, i;
+
+  if (frame_alloc (p) == NULL)
+    return false;
+
+  /* Extend the run forward, then backward, over slots holding
+     non-resident pages of ours. */
+  lo = hi = CENTER;
+  run[CENTER] = p;
+  while (hi - lo + 1 < SWAP_CLUSTER)
+    {
+      struct page *q = swap_lookup_own (p->swap_slot + (hi + 1 - CENTER));
+      if (q == NULL || q->frame != NULL || frame_try_alloc (q) == NULL)
+        break;
+      run[++hi] = q;
+    }
+  while (hi - lo + 1 < SWAP_CLUSTER && p->swap_slot >= CENTER - lo + 1)
+    {
+      struct page *q = swap_lookup_own (p->swap_slot - (CENTER - lo + 1));
+      if (q == NULL || q->frame != NULL || frame_try_alloc (q) == NULL)
+        break;
+      run[--lo] = q;
+    }
+
+  p->owner->major_fault_cnt++;
+  cnt = hi - lo + 1;
+  for (i = 0; i < cnt; i++)
+    kpages[i] = run[lo + i]->frame->kpage;
+  swap_in (run[lo]->swap_slot, kpages, cnt);
+
+  for (i = lo; i <= hi; i++)
+    if (run[i] != p)
+      {
+        run[i]->readahead = true;
+        if (!page_map (run[i]))
+          run[i]->readahead = false;
+      }
+  return page_map (p);
+}
+
+/* Sets the frame holding page P to F, which may be a null
+   pointer, counting P in or out of its owner's resident pages.
+   A page mapping the zero frame takes no memory of its own, so
+   it counts as resident only once it is unshared into a frame
+   of its own.  The caller must hold the frame table's lock. */
+void
+page_set_frame (struct page *p, struct frame *f)
+{
+  struct thread *t = p->owner;
+  bool was_resident = p->frame != NULL && !frame_is_zero (p->frame);
+  bool is_resident = f != NULL && !frame_is_zero (f);
+
+  if (!was_resident && is_resident)
+    {
+      if (++t->resident_cnt > t->peak_resident_cnt)
+        t->peak_resident_cnt = t->resident_cnt;
+    }
+  else if (was_resident && !is_resident)
+    t->resident_cnt--;
+  p->frame = f;
+}
+
+/* Fills in *MS with the running process's memory usage and
+   page fault counts.  The working-set size is as of the last
+   sweep of the working-set sampler. */
+void
+page_memstat (struct memstat *ms)
+{
+  struct thread *t = thread_current ();
+  struct hash_iterator i;
+
+  ms->resident_pages = t->resident_cnt;
+  ms->peak_resident_pages = t->peak_resident_cnt;
+  ms->working_set_pages = t->wset_cnt;
+  ms->shared_pages = ms->swapped_pages = 0;
+  hash_first (&i, &t->pages);
+  while (hash_next (&i))
+    {
+      struct page *p = hash_entry (hash_cur (&i), struct page, hash_elem);
+
+      if (frame_is_shared (p))
+        ms->shared_pages++;
+      else if (p->frame == NULL && p->swap_slot != SWAP_SLOT_NONE)
+        ms->swapped_pages++;
+    }
+  ms->major_faults = t->major_fault_cnt;
+  ms->minor_faults = t->page_fault_cnt - t->major_fault_cnt;
+}
+
+/* Maps page P, which must hold a pinned frame, into its owner's
+   page directory and unpins the frame.  Returns false if the
+   page table cannot be allocated, in which case the frame is
+   released. */
+bool
+page_map (struct page *p)
+{
+  ASSERT (p->frame != NULL && p->frame->pin_cnt > 0);
+
+  if (!pagedir_set_page (p->owner->pagedir, p->upage, p->frame->kpage,
+                         p->writable))
+    {
+      frame_unpin (p->frame);
+      frame_release (p);
+      return false;
+    }
+  frame_unpin (p->frame);
+  return true;
+}
+
+/* Removes P's mapping from its owner's page directory.  The
+   page table entry keeps its accessed and dirty bits. */
+void
+page_unmap (struct page *p)
+{
+  pagedir_clear_page (p->owner->pagedir, p->upage);
+}
+
+/* Writes mapped page P, which must be resident, back to its file
+   if it is dirty. */
+void
+page_write_back (struct page *p)
+{
+  ASSERT (p->frame != NULL);
+
+  if (p->mapped && pagedir_is_dirty (p->owner->pagedir, p->upage))
+    inode_write_uncached (file_get_inode (p->file), p->frame->kpage,
+                          p->read_bytes, p->file_ofs);
+}
+
+/* Evicts PAGES[0] through PAGES[CNT - 1], which must be
+   resident pages of a single process, from private frames.  The
+   pages that need writing (dirty ones, and anonymous ones never
+   written to swap) are given one run of contiguous slots.  If no such
+   run is free, only PAGES[0] is evicted and the others stay
+   resident.  Returns the number of pages evicted, which are
+   always PAGES[0] through PAGES[N - 1]; 0 means swap is full.
+
+   If IO_LOCK is not null, it is released while the pages are
+   written, and the caller must keep anyone from touching the
+   pages' frames until page_evict() returns. */
+size_t
+page_evict (struct page **pages, size_t cnt, struct lock *io_lock)
+{
+  bool dirty[SWAP_CLUSTER];
+  size_t i;
+
+  ASSERT (cnt > 0 && cnt <= SWAP_CLUSTER);
+
+  /* Unmap first, so the owner cannot dirty a page after we have
+     looked at its dirty bit. */
+  for (i = 0; i < cnt; i++)
+    {
+      struct page *p = pages[i];
+      ASSERT (p->frame != NULL);
+      page_unmap (p);
+      dirty[i] = pagedir_is_dirty (p->owner->pagedir, p->upage);
+      settle_readahead (p);
+    }
+
+  if (!evict_run (pages, cnt, dirty, io_lock))
+    {
+      for (i = 1; i < cnt; i++)
+        remap (pages[i], dirty[i]);
+      cnt = 1;
+      if (!evict_run (pages, cnt, dirty, io_lock))
+        {
+          remap (pages[0], dirty[0]);
+          return 0;
+        }
+    }
+
+  for (i = 0; i < cnt; i++)
+    page_set_frame (pages[i], NULL);
+  return cnt;
+}
+
+/* Writes those of the CNT unmapped PAGES that need it to a fresh
+   run of contiguous swap slots, releasing IO_LOCK, if it is not
+   null, during the writes.  DIRTY[] gives each page's dirty bit.
+   Returns false if no run of slots is free. */
+static bool
+evict_run (struct page **pages, size_t cnt, bool *dirty,
+           struct lock *io_lock)
+{
+  struct page *out[SWAP_CLUSTER];
+  size_t out_cnt = 0;
+  swap_slot_t first;
+  size_t i;
+
+  for (i = 0; i < cnt; i++)
+    if (dirty[i] || (pages[i]->swap_slot == SWAP_SLOT_NONE
+                     && pages[i]->file == NULL))
+      out[out_cnt++] = pages[i];
+  if (out_cnt == 0)
+    return true;
+
+  first = swap_alloc (out, out_cnt);
+  if (first == SWAP_SLOT_NONE)
+    return false;
+
+  for (i = 0; i < out_cnt; i++)
+    {
+      swap_free (out[i]);
+      out[i]->swap_slot = first + i;
+    }
+  if (io_lock != NULL)
+    lock_release (io_lock);
+  for (i = 0; i < out_cnt; i++)
+    swap_write (first + i, out[i]->frame->kpage);
+  if (io_lock != NULL)
+    lock_acquire (io_lock);
+  return true;
+}
+
+/* Maps resident page P again after a failed eviction, restoring
+   its DIRTY bit. */
+static void
+remap (struct page *p, bool dirty)
+{
+  uint32_t *pd = p->owner->pagedir;
+
+  pagedir_set_page (pd, p->upage, p->frame->kpage, p->writable);
+  pagedir_set_dirty (pd, p->upage, dirty);
+}
+
+/* If P was brought in by read-ahead and has not been counted
+   yet, counts it as a read-ahead hit if it has been accessed
+   since. */
+static void
+settle_readahead (struct page *p)
+{
+  if (p->readahead)
+    {
+      if (pagedir_is_accessed (p->owner->pagedir, p->upage))
+        swap_readahead_hit ();
+      p->readahead = false;
+    }
+}
+
+/* Returns true if P has been accessed since the last call, and
+   clears its accessed bit. */
+bool
+page_test_and_clear_accessed (struct page *p)
+{
+  bool accessed;
+
+  collect_accessed (p);
+  accessed = p->clock_ref;
+  p->clock_ref = false;
+  return accessed;
+}
+
+/* Shifts whether page P has been accessed since the last call
+   into its AGE, clearing its accessed bit, and counts it toward
+   its owner's working set if it is in it.  Called by the working
+   set sampler with the frame table's lock held. */
+void
+page_sample (struct page *p)
+{
+  collect_accessed (p);
+  p->age = (p->age >> 1) | (p->sample_ref ? 0x80 : 0);
+  p->sample_ref = false;
+  if (wset_contains (p))
+    p->owner->wset_next_cnt++;
+}
+
+/* Moves page P's hardware accessed bit, if set, into both the
+   clock's and the sampler's copies, so that each sees every
+   access whichever of them clears the bit first. */
+static void
+collect_accessed (struct page *p)
+{
+  uint32_t *pd = p->owner->pagedir;
+
+  if (pagedir_is_accessed (pd, p->upage))
+    {
+      settle_readahead (p);
+      pagedir_set_accessed (pd, p->upage, false);
+      p->clock_ref = p->sample_ref = true;
+    }
+}
+
+/* Returns a hash value for page E. */
+static unsigned
+page_hash (const struct hash_elem *e, void *aux UNUSED)
+{
+  const struct page *p = hash_entry (e, struct page, hash_elem);
+  return hash_bytes (&p->upage, sizeof p->upage);
+}
+
+/* Returns true if page A precedes page B. */
+static bool
+page_less (const struct hash_elem *a_, const struct hash_elem *b_,
+           void *aux UNUSED)
+{
+  const struct page *a = hash_entry (a_, struct page, hash_elem);
+  const struct page *b = hash_entry (b_, struct page, hash_elem);
+  return a->upage < b->upage;
+}
+
+/* Frees page E along with its frame and swap slot. */
+static void
+page_destroy (struct hash_elem *e, void *aux UNUSED)
+{
+  struct page *p = hash_entry (e, struct page, hash_elem);
+
+  settle_readahead (p);
+  frame_release (p);
+  swap_free (p);
+  free (p);
+}
@@ -0,0 +1,75 @@
+#ifndef VM_PAGE_H
+#define VM_PAGE_H
+
+#include <hash.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include "filesys/off_t.h"
+#include "threads/thread.h"
+#include "vm/swap.h"
+
+/* A user virtual page, as recorded in its owner's supplemental
+   page table.  Besides the hardware page table, this is where
+   the kernel looks to find out what belongs at an address after
+   the page has been evicted.
+
+   A page with a FILE is loaded from READ_BYTES bytes at FILE_OFS
+   in FILE, the rest of it zeroed.  If it is MAPPED, FILE is also
+   where it is written back to; otherwise it goes to swap like an
+   anonymous page once it has been written to.  A MAPPED page,
+   and a read-only one that holds all of its page of the file,
+   maps the file's page in the page cache directly, sharing it
+   with every other page that does (see vm/frame.c). */
+struct page
+  {
+    void *upage;                /* User virtual address. */
+    struct thread *owner;       /* Owning thread. */
+    bool writable;              /* Writable by the user process? */
+    struct frame *frame;        /* Frame holding the page, or null. */
+    struct list_elem frame_elem; /* Element in the frame's `pages'. */
+    swap_slot_t swap_slot;      /* Swap copy, or SWAP_SLOT_NONE. */
+    bool readahead;             /* Read ahead and not yet seen used? */
+    uint8_t age;                /* Recent samples, newest in bit 7. */
+    bool clock_ref;             /* Accessed since the clock last passed? */
+    bool sample_ref;            /* Accessed since last sampled? */
+
+    struct file *file;          /* Backing file, or null. */
+    off_t file_ofs;             /* Offset of the page in FILE. */
+    size_t read_bytes;          /* Bytes to read from FILE. */
+    bool mapped;                /* Memory-mapped: written back to FILE. */
+
+    struct hash_elem hash_elem; /* Element in the owner's `pages'. */
+  };
+
+struct lock;
+struct memstat;
+
+/* Maximum size of a user stack, in pages. */
+extern size_t stack_page_limit;
+
+/* Fault-around window size, in pages, and pages mapped by it. */
+extern size_t fault_around_pages;
+extern long long fault_around_cnt;
+
+bool page_table_init (struct hash *);
+void page_table_destroy (struct hash *);
+bool page_table_fork (struct thread *parent);
+
+struct page *page_create (void *upage, bool writable);
+struct page *page_lookup (struct thread *, const void *uaddr);
+void page_remove (struct page *);
+void page_remove_range (void *upage, size_t page_cnt);
+bool page_in (void *fault_addr, bool write);
+bool page_unshare (void *fault_addr);
+bool page_is_stack_access (const void *uaddr, const void *esp);
+bool page_grow_stack (void *fault_addr, const void *esp);
+void page_set_frame (struct page *, struct frame *);
+void page_memstat (struct memstat *);
+bool page_map (struct page *);
+void page_unmap (struct page *);
+void page_write_back (struct page *);
+size_t page_evict (struct page **, size_t cnt, struct lock *io_lock);
+bool page_test_and_clear_accessed (struct page *);
+void page_sample (struct page *);
+
+#endif /* vm/page.h */
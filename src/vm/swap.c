@@ -0,0 +1,407 @@
+#include "vm/swap.h"
+#include <bitmap.h>
+#include <debug.h>
+#include <list.h>
+#include <lz.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include "devices/block.h"
+#include "threads/malloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "vm/page.h"
+
+/* Swap slot allocator.
+
+   The swap device is divided into page-sized slots of
+   SECTORS_PER_PAGE consecutive sectors each.  A bitmap records
+   which slots hold a swapped-out page, and SLOT_PAGES maps each
+   used slot back to the page it was allocated for.
+
+   After a fork, parent and child refer to the same slots for the
+   pages they still share, so each slot has a reference count in
+   SLOT_REFS.  Only the page the slot was allocated for is found
+   through SLOT_PAGES, and only while it still refers to it.
+
+   Pages evicted together are given a run of contiguous slots
+   (a "cluster"), so they go out as one sequential sweep of the
+   disk.  On a fault, page_in() looks up the slots next to the
+   faulting page's slot with swap_lookup_own() and reads the
+   neighbours that belong to the same process along with it.
+
+   A page keeps its slot after it is read back in, so that a
+   clean page can be evicted again without rewriting it (see
+   page_evict()).
+
+   In front of the device sits a cache of compressed pages.
+   swap_write() compresses the page with the LZ codec and, if it
+   shrinks to ZCACHE_MAX_SIZE bytes or less, keeps it in kernel
+   memory instead of writing it out, filed under its slot in
+   SLOT_ZPAGES.  The cache holds at most ZCACHE_PAGE_LIMIT pages'
+   worth of compressed data.  When it is full, the entries used
+   least recently, at the back of ZCACHE_LRU, are decompressed and
+   written to their slots on the device to make room.  swap_in()
+   takes each page from the cache if it is there, and from the
+   device otherwise.  Either way the slot keeps its contents until
+   it is freed, which also drops its cache entry. */
+
+/* Number of sectors in a page. */
+#define SECTORS_PER_PAGE (PGSIZE / BLOCK_SECTOR_SIZE)
+
+/* Largest compressed page worth caching. */
+#define ZCACHE_MAX_SIZE (PGSIZE / 2)
+
+/* A compressed page in the cache. */
+struct zpage
+  {
+    struct list_elem lru_elem;  /* Element in ZCACHE_LRU. */
+    swap_slot_t slot;           /* Slot it belongs in. */
+    size_t size;                /* Bytes in DATA. */
+    uint8_t data[];             /* Compressed contents. */
+  };
+
+/* -zs: Maximum compressed data to cache, in pages. */
+size_t zcache_page_limit = 32;
+
+static struct block *swap_device;       /* Swap block device. */
+static struct bitmap *used_slots;       /* Slots in use. */
+static struct page **slot_pages;        /* Page stored in each slot. */
+static unsigned *slot_refs;             /* References to each slot. */
+static struct lock swap_lock;           /* Protects the above. */
+
+static struct zpage **slot_zpages;      /* Cached page for each slot. */
+static struct list zcache_lru;          /* Cached pages, most recent first. */
+static size_t zcache_bytes;             /* Bytes of compressed data. */
+static uint8_t zcache_buf[PGSIZE];      /* Compression output, bounce page. */
+static unsigned short lz_work[LZ_WORK_SIZE / sizeof (unsigned short)];
+static struct lock zcache_lock;         /* Protects the above. */
+
+/* Statistics. */
+static long long swap_out_cnt;          /* Pages written to swap. */
+static long long swap_cluster_cnt;      /* Clusters allocated. */
+static long long swap_in_cnt;           /* Pages read on demand. */
+static long long readahead_cnt;         /* Pages read ahead. */
+static long long readahead_hit_cnt;     /* Read-ahead pages used. */
+static long long zcache_store_cnt;      /* Pages compressed into the cache. */
+static long long zcache_store_bytes;    /* Their total compressed size. */
+static long long zcache_reject_cnt;     /* Pages that did not compress. */
+static long long zcache_writeback_cnt;  /* Pages written back to the device. */
+static long long zcache_hit_cnt;        /* Pages read from the cache. */
+static long long zcache_miss_cnt;       /* Pages read from the device. */
+
+static void write_slot (swap_slot_t, const void *kpage);
+static void read_slot (swap_slot_t, void *kpage);
+static bool zcache_store (swap_slot_t, const void *kpage);
+static bool zcache_load (swap_slot_t, void *kpage);
+static void zcache_drop (swap_slot_t);
+static void zcache_write_back (void);
+
+/* Initializes the swap slot allocator on the block device
+   playing the BLOCK_SWAP role.  If there is no swap device,
+   swapping is disabled and swap_alloc() always fails. */
+void
+swap_init (void)
+{
+  size_t slot_cnt;
+
+  lock_init (&swap_lock);
+  lock_init (&zcache_lock);
+  list_init (&zcache_lru);
+  swap_device = block_get_role (BLOCK_SWAP);
+  if (swap_device == NULL)
+    {
+      printf ("swap: no swap device, swapping disabled\n");
+      return;
+    }
+
+  slot_cnt = block_size (swap_device) / SECTORS_PER_PAGE;
+  used_slots = bitmap_create (slot_cnt);
+  slot_pages = calloc (slot_cnt, sizeof *slot_pages);
+  slot_refs = calloc (slot_cnt, sizeof *slot_refs);
+  slot_zpages = calloc (slot_cnt, sizeof *slot_zpages);
+  if (used_slots == NULL || slot_pages == NULL || slot_refs == NULL
+      || slot_zpages == NULL)
+    PANIC ("swap: cannot allocate slot tables");
+  printf ("swap: %zu slots on %s\n", slot_cnt, block_name (swap_device));
+}
+
+/* Allocates a run of CNT contiguous slots for PAGES[0] through
+   PAGES[CNT - 1], in that order, and returns the first slot.
+   Returns SWAP_SLOT_NONE if no such run is free or there is no
+   swap device. */
+swap_slot_t
+swap_alloc (struct page **pages, size_t cnt)
+{
+  swap_slot_t first;
+  size_t i;
+
+  ASSERT (cnt > 0);
+  if (used_slots == NULL)
+    return SWAP_SLOT_NONE;
+
+  lock_acquire (&swap_lock);
+  first = bitmap_scan_and_flip (used_slots, 0, cnt, false);
+  if (first != BITMAP_ERROR)
+    {
+      for (i = 0; i < cnt; i++)
+        {
+          slot_pages[first + i] = pages[i];
+          slot_refs[first + i] = 1;
+        }
+      swap_cluster_cnt++;
+    }
+  lock_release (&swap_lock);
+
+  return first != BITMAP_ERROR ? first : SWAP_SLOT_NONE;
+}
+
+/* Writes the page at KPAGE into SLOT, which must already be
+   allocated, keeping it compressed in memory if it compresses
+   well enough. */
+void
+swap_write (swap_slot_t slot, const void *kpage)
+{
+  ASSERT (slot != SWAP_SLOT_NONE);
+  ASSERT (bitmap_test (used_slots, slot));
+
+  if (!zcache_store (slot, kpage))
+    write_slot (slot, kpage);
+  swap_out_cnt++;
+}
+
+/* Reads the CNT pages stored in the contiguous slots starting at
+   FIRST into KPAGES[0] through KPAGES[CNT - 1], in order, so
+   that the pages not in the compressed cache are read as one
+   sequential sweep of the device.  The slots stay allocated;
+   release them with swap_free().  All but one of the pages are
+   counted as read ahead. */
+void
+swap_in (swap_slot_t first, void **kpages, size_t cnt)
+{
+  size_t i;
+
+  ASSERT (first != SWAP_SLOT_NONE);
+  ASSERT (cnt > 0);
+  ASSERT (bitmap_all (used_slots, first, cnt));
+
+  for (i = 0; i < cnt; i++)
+    if (!zcache_load (first + i, kpages[i]))
+      read_slot (first + i, kpages[i]);
+  swap_in_cnt++;
+  readahead_cnt += cnt - 1;
+}
+
+/* Returns the page stored in SLOT if it belongs to the running
+   thread, otherwise a null pointer. */
+struct page *
+swap_lookup_own (swap_slot_t slot)
+{
+  struct page *p = NULL;
+
+  if (used_slots == NULL || slot >= bitmap_size (used_slots))
+    return NULL;
+
+  lock_acquire (&swap_lock);
+  if (bitmap_test (used_slots, slot) && slot_pages[slot] != NULL
+      && slot_pages[slot]->owner == thread_current ())
+    p = slot_pages[slot];
+  lock_release (&swap_lock);
+  return p;
+}
+
+/* Adds a reference to SLOT and returns it.  SWAP_SLOT_NONE is
+   returned as is. */
+swap_slot_t
+swap_dup (swap_slot_t slot)
+{
+  if (slot == SWAP_SLOT_NONE)
+    return slot;
+
+  lock_acquire (&swap_lock);
+  ASSERT (bitmap_test (used_slots, slot));
+  slot_refs[slot]++;
+  lock_release (&swap_lock);
+  return slot;
+}
+
+/* Drops P's reference to its swap slot, if it has one, and
+   releases the slot once no page refers to it. */
+void
+swap_free (struct page *p)
+{
+  swap_slot_t slot = p->swap_slot;
+
+  if (slot == SWAP_SLOT_NONE)
+    return;
+
+  lock_acquire (&swap_lock);
+  ASSERT (bitmap_test (used_slots, slot));
+  if (slot_pages[slot] == p)
+    slot_pages[slot] = NULL;
+  if (--slot_refs[slot] == 0)
+    {
+      zcache_drop (slot);
+      bitmap_reset (used_slots, slot);
+    }
+  lock_release (&swap_lock);
+  p->swap_slot = SWAP_SLOT_NONE;
+}
+
+/* Records that a page brought in by read-ahead was used. */
+void
+swap_readahead_hit (void)
+{
+  readahead_hit_cnt++;
+}
+
+/* Prints swap statistics. */
+void
+swap_print_stats (void)
+{
+  printf ("Swap: %lld pages out in %lld clusters, %lld faults read in, "
+          "%lld pages read ahead, %lld hits (%lld%%)\n",
+          swap_out_cnt, swap_cluster_cnt, swap_in_cnt, readahead_cnt,
+          readahead_hit_cnt,
+          readahead_cnt > 0 ? readahead_hit_cnt * 100 / readahead_cnt : 0);
+  printf ("Compressed swap: %lld pages stored (%lld%% of original size), "
+          "%lld incompressible, %lld written back\n",
+          zcache_store_cnt,
+          zcache_store_cnt > 0
+          ? zcache_store_bytes * 100 / (zcache_store_cnt * PGSIZE) : 0,
+          zcache_reject_cnt, zcache_writeback_cnt);
+  printf ("Compressed swap: %lld pages read from cache, %lld from device "
+          "(%lld%% hits)\n",
+          zcache_hit_cnt, zcache_miss_cnt,
+          zcache_hit_cnt + zcache_miss_cnt > 0
+          ? zcache_hit_cnt * 100 / (zcache_hit_cnt + zcache_miss_cnt) : 0);
+}
+
+/* Writes the page at KPAGE to SLOT on the swap device. */
+static void
+write_slot (swap_slot_t slot, const void *kpage)
+{
+  size_t i;
+
+  for (i = 0; i < SECTORS_PER_PAGE; i++)
+    block_write (swap_device, slot * SECTORS_PER_PAGE + i,
+                 (const uint8_t *) kpage + i * BLOCK_SECTOR_SIZE);
+}
+
+/* Reads the page in SLOT on the swap device into KPAGE. */
+static void
+read_slot (swap_slot_t slot, void *kpage)
+{
+  size_t i;
+
+  for (i = 0; i < SECTORS_PER_PAGE; i++)
+    block_read (swap_device, slot * SECTORS_PER_PAGE + i,
+                (uint8_t *) kpage + i * BLOCK_SECTOR_SIZE);
+  zcache_miss_cnt++;
+}
+
+/* Compresses the page at KPAGE into the cache as the contents of
+   SLOT, writing back older entries to make room as needed.
+   Returns false if the page does not compress well enough or the
+   cache is disabled or out of memory, in which case the caller
+   must write it to the device itself. */
+static bool
+zcache_store (swap_slot_t slot, const void *kpage)
+{
+  struct zpage *z;
+  size_t size;
+
+  if (zcache_page_limit == 0)
+    return false;
+
+  lock_acquire (&zcache_lock);
+  ASSERT (slot_zpages[slot] == NULL);
+  size = lz_compress (kpage, PGSIZE, zcache_buf, ZCACHE_MAX_SIZE, lz_work);
+  if (size == 0)
+    {
+      zcache_reject_cnt++;
+      lock_release (&zcache_lock);
+      return false;
+    }
+  z = malloc (offsetof (struct zpage, data) + size);
+  if (z == NULL)
+    {
+      lock_release (&zcache_lock);
+      return false;
+    }
+  z->slot = slot;
+  z->size = size;
+  memcpy (z->data, zcache_buf, size);
+
+  while (zcache_bytes + size > zcache_page_limit * PGSIZE
+         && !list_empty (&zcache_lru))
+    zcache_write_back ();
+  list_push_front (&zcache_lru, &z->lru_elem);
+  slot_zpages[slot] = z;
+  zcache_bytes += size;
+  zcache_store_cnt++;
+  zcache_store_bytes += size;
+  lock_release (&zcache_lock);
+  return true;
+}
+
+/* Decompresses the contents of SLOT into KPAGE if they are in
+   the cache, making them the most recently used entry.  Returns
+   true if successful, false if SLOT is not cached. */
+static bool
+zcache_load (swap_slot_t slot, void *kpage)
+{
+  struct zpage *z;
+
+  lock_acquire (&zcache_lock);
+  z = slot_zpages[slot];
+  if (z != NULL)
+    {
+      if (!lz_decompress (z->data, z->size, kpage, PGSIZE))
+        PANIC ("swap: compressed page in slot %zu is corrupt", slot);
+      list_remove (&z->lru_elem);
+      list_push_front (&zcache_lru, &z->lru_elem);
+      zcache_hit_cnt++;
+    }
+  lock_release (&zcache_lock);
+  return z != NULL;
+}
+
+/* Discards the cached contents of SLOT, if any. */
+static void
+zcache_drop (swap_slot_t slot)
+{
+  struct zpage *z;
+
+  lock_acquire (&zcache_lock);
+  z = slot_zpages[slot];
+  if (z != NULL)
+    {
+      list_remove (&z->lru_elem);
+      slot_zpages[slot] = NULL;
+      zcache_bytes -= z->size;
+      free (z);
+    }
+  lock_release (&zcache_lock);
+}
+
+/* Writes the least recently used cache entry back to its slot on
+   the device and discards it.  The cache's lock stays held
+   throughout, so no one reads the slot before it is written. */
+static void
+zcache_write_back (void)
+{
+  struct zpage *z;
+
+  ASSERT (lock_held_by_current_thread (&zcache_lock));
+
+  z = list_entry (list_pop_back (&zcache_lru), struct zpage, lru_elem);
+  if (!lz_decompress (z->data, z->size, zcache_buf, PGSIZE))
+    PANIC ("swap: compressed page in slot %zu is corrupt", z->slot);
+  write_slot (z->slot, zcache_buf);
+  slot_zpages[z->slot] = NULL;
+  zcache_bytes -= z->size;
+  free (z);
+  zcache_writeback_cnt++;
+}
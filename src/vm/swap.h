@@ -0,0 +1,28 @@
+#ifndef VM_SWAP_H
+#define VM_SWAP_H
+
+#include <stddef.h>
+
+struct page;
+
+/* Index of a page-sized slot on the swap device. */
+typedef size_t swap_slot_t;
+#define SWAP_SLOT_NONE ((swap_slot_t) -1)  /* No slot assigned. */
+
+/* Maximum number of pages written or read in one cluster. */
+#define SWAP_CLUSTER 8
+
+/* Maximum compressed swap kept in memory, in pages. */
+extern size_t zcache_page_limit;
+
+void swap_init (void);
+swap_slot_t swap_alloc (struct page **, size_t cnt);
+void swap_write (swap_slot_t, const void *kpage);
+void swap_in (swap_slot_t first, void **kpages, size_t cnt);
+struct page *swap_lookup_own (swap_slot_t);
+swap_slot_t swap_dup (swap_slot_t);
+void swap_free (struct page *);
+void swap_readahead_hit (void);
+void swap_print_stats (void);
+
+#endif /* vm/swap.h */
@@ -0,0 +1,116 @@
+#include "vm/wset.h"
+#include <debug.h>
+#include <stdio.h>
+#include "devices/timer.h"
+#include "threads/interrupt.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "vm/frame.h"
+#include "vm/page.h"
+
+/* Working-set estimation.
+
+   Every WSET_INTERVAL ticks, the timer interrupt wakes a kernel
+   thread that samples the accessed bit of every resident user
+   page.  Each page keeps the last WSET_MAX_WINDOW samples in its
+   AGE, the newest in the high bit (see page_sample()).  A page is
+   in its process's working set if it was accessed in any of the
+   last WSET_WINDOW samples, and the working-set size is the
+   number of such pages, counted during each sweep and published
+   to the process's WSET_CNT at its end.
+
+   The sweep runs in batches of SAMPLE_BATCH frames under the
+   frame table's lock, yielding between batches, so it never
+   holds up the timer interrupt or faults for long.  The clock
+   sweep prefers to evict pages outside the working set. */
+
+/* Frames sampled at a time. */
+#define SAMPLE_BATCH 32
+
+unsigned wset_interval = TIMER_FREQ / 4;
+unsigned wset_window = 4;
+
+static struct semaphore sample_wake;    /* Upped to start a sweep. */
+static bool sample_pending;             /* SAMPLE_WAKE upped? */
+static bool started;                    /* Sampler thread running? */
+
+/* Statistics. */
+static long long sweep_cnt;             /* Sweeps completed. */
+
+static thread_func sample_thread;
+static void publish (struct thread *, void *aux);
+
+/* Starts the sampler thread. */
+void
+wset_init (void)
+{
+  ASSERT (wset_window >= 1 && wset_window <= WSET_MAX_WINDOW);
+
+  sema_init (&sample_wake, 0);
+  sample_pending = false;
+  if (thread_create ("wset", PRI_DEFAULT, sample_thread, NULL) != TID_ERROR)
+    started = true;
+}
+
+/* Called by the timer interrupt handler at each timer tick.
+   Wakes the sampler every WSET_INTERVAL ticks, unless it is
+   still busy with the last sweep. */
+void
+wset_tick (int64_t ticks)
+{
+  ASSERT (intr_context ());
+
+  if (started && wset_interval > 0 && ticks % wset_interval == 0
+      && !sample_pending)
+    {
+      sample_pending = true;
+      sema_up (&sample_wake);
+    }
+}
+
+/* Returns true if page P was accessed in any of the last
+   WSET_WINDOW samples. */
+bool
+wset_contains (const struct page *p)
+{
+  return (p->age >> (WSET_MAX_WINDOW - wset_window)) != 0;
+}
+
+/* Prints working-set statistics. */
+void
+wset_print_stats (void)
+{
+  printf ("Working set: %lld sweeps, window of %u samples every "
+          "%u ticks\n", sweep_cnt, wset_window, wset_interval);
+}
+
+/* Sampler thread.  Each time it is woken up, sweeps every frame
+   once, then publishes the counts. */
+static void
+sample_thread (void *aux UNUSED)
+{
+  for (;;)
+    {
+      enum intr_level old_level;
+
+      sema_down (&sample_wake);
+      while (!frame_sample (SAMPLE_BATCH))
+        thread_yield ();
+
+      old_level = intr_disable ();
+      thread_foreach (publish, NULL);
+      intr_set_level (old_level);
+
+      sweep_cnt++;
+      sample_pending = false;
+    }
+}
+
+/* Makes the working-set size counted for T during the sweep
+   just finished its current one, and starts counting again. */
+static void
+publish (struct thread *t, void *aux UNUSED)
+{
+  t->wset_cnt = t->wset_next_cnt;
+  t->wset_next_cnt = 0;
+}
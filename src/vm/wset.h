@@ -0,0 +1,24 @@
+#ifndef VM_WSET_H
+#define VM_WSET_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+struct page;
+
+/* Ticks between samples of the accessed bits; 0 disables
+   sampling. */
+extern unsigned wset_interval;
+
+/* Number of most recent samples a page must have been accessed
+   in to count as part of its process's working set, from 1 to
+   WSET_MAX_WINDOW. */
+#define WSET_MAX_WINDOW 8
+extern unsigned wset_window;
+
+void wset_init (void);
+void wset_tick (int64_t ticks);
+bool wset_contains (const struct page *);
+void wset_print_stats (void);
+
+#endif /* vm/wset.h */